@@ -0,0 +1,410 @@
+#ifndef ANIMATION_SCRIPT_H
+#define ANIMATION_SCRIPT_H
+
+#include <Arduino.h>
+#include <flash_hal.h>
+#include "Config.h"
+#include "Crc32.h"
+#include "FrameBuffer.h"
+#include "Scene.h"
+#include "Waveform.h"
+
+/**
+** ============================================================================
+** ANIMATION SCRIPT - Effects uploaded as bytecode instead of firmware
+** ============================================================================
+**
+** A script is a small program that draws one frame from the scene time. It
+** is uploaded once with CMD_SCRIPT, kept in flash and played with
+** CMD_SET_MOOD type 5 (STRATEGY_SCRIPT). The scene's three colors are its
+** parameters, so one upload serves every color the app picks. Like the
+** built-in strategies it is a pure function of time, so grouped lamps that
+** share the network clock play it in phase.
+**
+** Program: [FORMAT, colorCount, RGB x colorCount, code..., OP_END]
+**
+** The machine has eight int32 registers, cleared at the start of every
+** frame, and a palette: colors 0-2 come from the scene, 3 onwards from the
+** program header. All arithmetic is integer. Levels and wave samples are
+** 0..255, phases are 0..65535 and MUL is 8.8 fixed point (x * y / 256).
+** Each frame starts black; pixels that are not drawn stay off.
+**
+** There are no jumps. The only control flow is LOOP/NEXT with a constant
+** count, so analyze() computes the exact number of instructions a frame
+** executes at upload and rejects programs above SCRIPT_STEP_BUDGET. Each
+** instruction does a bounded amount of work, which puts a known ceiling on
+** the cost of a frame. The interpreter never runs more than the budget
+** either, and trusts a program only once analyze() has accepted it.
+**
+** README.md has the wire format of each instruction and an example.
+**/
+namespace Script {
+    constexpr uint8_t FORMAT = 1;
+    constexpr uint8_t REGISTERS = 8;
+    constexpr uint8_t SCENE_COLORS = 3;
+    constexpr uint8_t MAX_COLORS = 5;      // Program palette, after the scene's
+
+    // Register operands are one byte, or packed two to a byte as hi<<4 | lo
+    enum Op : uint8_t {
+        OP_END   = 0x00,                   // []                 Last byte of every program
+        OP_SET   = 0x01,                   // [d, imm16]         r[d] = imm (signed)
+        OP_MOV   = 0x02,                   // [d<<4|s]           r[d] = r[s]
+        OP_ADD   = 0x03,                   // [d<<4|s]           r[d] += r[s]
+        OP_SUB   = 0x04,                   // [d<<4|s]           r[d] -= r[s]
+        OP_MUL   = 0x05,                   // [d<<4|s]           r[d] = r[d] * r[s] / 256
+        OP_MOD   = 0x06,                   // [d<<4|s]           r[d] mod r[s], in [0, r[s]); 0 if r[s] <= 0
+        OP_ADDI  = 0x07,                   // [d, imm16]         r[d] += imm (signed)
+        OP_SHR   = 0x08,                   // [d, n]             r[d] >>= n, arithmetic, n < 32
+        OP_TIME  = 0x09,                   // [d, period u16]    r[d] = phase of the scene time in period ms
+        OP_SINE  = 0x0A,                   // [d]                r[d] = sine of phase r[d], 0..255
+        OP_TRI   = 0x0B,                   // [d]                r[d] = triangle of phase r[d], 0..255..0
+        OP_KEYS  = 0x0C,                   // [d, n, (x, y) x n] r[d] = keyframe curve at x = r[d]
+        OP_LOOP  = 0x0D,                   // [d, count]         Run up to NEXT count times (0 = every pixel), r[d] = 0, 1, ...
+        OP_NEXT  = 0x0E,                   // []
+        OP_PIXEL = 0x0F,                   // [i<<4|l, c]        Pixel r[i] mod pixels = color c at level r[l]
+        OP_BLEND = 0x10,                   // [i<<4|t, a<<4|b]   Pixel r[i] = color a..b at r[t] (0 = a, 255 = b)
+        OP_FILL  = 0x11,                   // [l<<4|c]           Every pixel = color c at level r[l]
+        OP_COUNT
+    };
+
+    // Operand bytes per opcode; OP_KEYS adds 2 per keyframe
+    static constexpr uint8_t OPERANDS[OP_COUNT] = {
+        0, 3, 1, 1, 1, 1, 1, 3, 2, 3, 1, 1, 2, 2, 0, 2, 2, 1
+    };
+
+    // STATUS_SCRIPT result codes
+    enum Result : uint8_t {
+        OK,
+        EMPTY,                            // Query: no program stored
+        BAD_HEADER,
+        TOO_LARGE,
+        TRUNCATED,                        // Ends inside an instruction or without OP_END
+        BAD_OPCODE,
+        BAD_OPERAND,                      // Register, palette index, period or keyframes out of range
+        BAD_LOOP,                         // Unbalanced LOOP/NEXT or nested too deep
+        OVER_BUDGET,                      // More than SCRIPT_STEP_BUDGET instructions per frame
+        NOT_STORED                        // Accepted and playing, but the flash write failed
+    };
+}
+
+struct ScriptAnalysis {
+    Script::Result result;
+    uint16_t offset;                      // Of the offending byte
+    uint16_t steps;                       // Instructions per frame, if accepted
+};
+
+class ScriptProgram {
+private:
+    struct Loop {
+        uint16_t start;                   // First instruction of the body
+        uint16_t index;
+        uint16_t count;
+        uint8_t reg;
+    };
+
+    uint8_t bytes[SCRIPT_MAX_SIZE];
+    uint16_t length;                      // 0 = nothing loaded
+    uint16_t codeStart;
+    uint16_t steps;
+    uint32_t crc;
+
+    static uint8_t hi(uint8_t operand) { return operand >> 4; }
+    static uint8_t lo(uint8_t operand) { return operand & 0x0F; }
+
+    static int16_t imm16(const uint8_t* p) {
+        return static_cast<int16_t>(p[0] | (p[1] << 8));
+    }
+
+    static uint8_t operandBytes(uint8_t op, const uint8_t* operands) {
+        return op == Script::OP_KEYS ? 2 + 2 * operands[1] : Script::OPERANDS[op];
+    }
+
+    static uint8_t toByte(int32_t value) {
+        return static_cast<uint8_t>(constrain(value, 0, 255));
+    }
+
+    // LOOP 0 runs once per pixel: LED_MAX times as far as analyze() knows
+    static uint16_t loopCount(uint8_t count, uint16_t pixels = LED_MAX) {
+        return count ? count : pixels;
+    }
+
+    static uint16_t pixelAt(int32_t value, uint16_t pixels) {
+        int32_t index = value % pixels;
+        return static_cast<uint16_t>(index < 0 ? index + pixels : index);
+    }
+
+    static uint8_t curve(const uint8_t* keys, uint8_t n, uint8_t x) {
+        if (x <= keys[0]) return keys[1];
+
+        for (uint8_t i = 1; i < n; i++) {
+            const uint8_t* a = &keys[2 * (i - 1)];
+            const uint8_t* b = &keys[2 * i];
+            if (x <= b[0]) return static_cast<uint8_t>(a[1] + (b[1] - a[1]) * (x - a[0]) / (b[0] - a[0]));
+        }
+        return keys[2 * n - 1];
+    }
+
+    [[nodiscard]] Color color(uint8_t index, const Scene& scene) const {
+        if (index < Script::SCENE_COLORS) return scene.color(index);
+
+        const uint8_t* p = &bytes[2 + 3 * (index - Script::SCENE_COLORS)];
+        return Color(p[0], p[1], p[2]);
+    }
+
+public:
+    ScriptProgram() : bytes{}, length(0), codeStart(0), steps(0), crc(0) {}
+
+    /**
+     * Check a program without running it: every opcode and operand is in
+     * range, loops balance and the program ends with OP_END. Also counts the
+     * instructions one frame executes, each weighted by the counts of its
+     * enclosing loops.
+     */
+    static ScriptAnalysis analyze(const uint8_t* data, size_t len) {
+        using namespace Script;
+        if (len > SCRIPT_MAX_SIZE) return {TOO_LARGE, SCRIPT_MAX_SIZE, 0};
+        if (len < 2 || data[0] != FORMAT || data[1] > MAX_COLORS) return {BAD_HEADER, 0, 0};
+
+        uint8_t palette = SCENE_COLORS + data[1];
+        uint32_t weights[SCRIPT_MAX_DEPTH];
+        uint8_t depth = 0;
+        uint32_t weight = 1;
+        uint32_t total = 0;
+
+        size_t pc = 2 + 3 * data[1];
+        while (pc < len) {
+            uint16_t at = static_cast<uint16_t>(pc);
+            uint8_t op = data[pc++];
+            if (op >= OP_COUNT) return {BAD_OPCODE, at, 0};
+            if (op == OP_KEYS && pc + 2 > len) return {TRUNCATED, at, 0};
+
+            const uint8_t* a = &data[pc];
+            pc += operandBytes(op, a);
+            if (pc > len) return {TRUNCATED, at, 0};
+
+            total += weight;
+            if (total > SCRIPT_STEP_BUDGET) return {OVER_BUDGET, at, 0};
+
+            bool valid = true;
+            switch (op) {
+                case OP_END:
+                    if (depth > 0) return {BAD_LOOP, at, 0};
+                    if (pc != len) return {BAD_OPCODE, static_cast<uint16_t>(pc), 0};
+                    return {OK, 0, static_cast<uint16_t>(total)};
+                case OP_SET:
+                case OP_ADDI:
+                case OP_SINE:
+                case OP_TRI:
+                    valid = a[0] < REGISTERS;
+                    break;
+                case OP_MOV:
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_MOD:
+                    valid = hi(a[0]) < REGISTERS && lo(a[0]) < REGISTERS;
+                    break;
+                case OP_SHR:
+                    valid = a[0] < REGISTERS && a[1] < 32;
+                    break;
+                case OP_TIME:
+                    valid = a[0] < REGISTERS && (a[1] | a[2]) != 0;
+                    break;
+                case OP_KEYS:
+                    valid = a[0] < REGISTERS && a[1] >= 1 && a[1] <= SCRIPT_MAX_KEYS;
+                    for (uint8_t i = 1; valid && i < a[1]; i++) {
+                        valid = a[2 + 2 * i] > a[2 * i];          // x strictly increasing
+                    }
+                    break;
+                case OP_LOOP:
+                    if (depth == SCRIPT_MAX_DEPTH) return {BAD_LOOP, at, 0};
+                    valid = a[0] < REGISTERS;
+                    weights[depth++] = weight;
+                    weight *= loopCount(a[1]);
+                    break;
+                case OP_NEXT:
+                    if (depth == 0) return {BAD_LOOP, at, 0};
+                    weight = weights[--depth];
+                    break;
+                case OP_PIXEL:
+                    valid = hi(a[0]) < REGISTERS && lo(a[0]) < REGISTERS && a[1] < palette;
+                    break;
+                case OP_BLEND:
+                    valid = hi(a[0]) < REGISTERS && lo(a[0]) < REGISTERS &&
+                            hi(a[1]) < palette && lo(a[1]) < palette;
+                    break;
+                case OP_FILL:
+                    valid = hi(a[0]) < REGISTERS && lo(a[0]) < palette;
+                    break;
+            }
+            if (!valid) return {BAD_OPERAND, at, 0};
+        }
+        return {TRUNCATED, static_cast<uint16_t>(len), 0};
+    }
+
+    // Replace the program if `data` passes analyze(); the old one stays otherwise
+    ScriptAnalysis load(const uint8_t* data, size_t len) {
+        ScriptAnalysis analysis = analyze(data, len);
+        if (analysis.result != Script::OK) return analysis;
+
+        memcpy(bytes, data, len);
+        length = static_cast<uint16_t>(len);
+        codeStart = 2 + 3 * data[1];
+        steps = analysis.steps;
+        crc = Crc32::compute(data, len);
+        return analysis;
+    }
+
+    void clear() { length = 0; }
+
+    /**
+     * Draw one frame at scene time `time`. Returns false if no program is
+     * loaded (the frame is left untouched).
+     */
+    bool run(FrameBuffer* frame, unsigned long time, const Scene& scene) const {
+        using namespace Script;
+        uint16_t pixels = frame->length();
+        if (length == 0 || pixels == 0) return false;
+
+        int32_t r[REGISTERS] = {};
+        Loop loops[SCRIPT_MAX_DEPTH];
+        uint8_t depth = 0;
+        uint16_t pc = codeStart;
+
+        frame->fill(Colors::OFF);
+        for (uint16_t step = 0; step < SCRIPT_STEP_BUDGET; step++) {
+            uint8_t op = bytes[pc++];
+            const uint8_t* a = &bytes[pc];
+            pc += operandBytes(op, a);
+
+            switch (op) {
+                case OP_END:
+                    return true;
+                case OP_SET:  r[a[0]] = imm16(a + 1); break;
+                case OP_MOV:  r[hi(a[0])] = r[lo(a[0])]; break;
+                case OP_ADD:  r[hi(a[0])] += r[lo(a[0])]; break;
+                case OP_SUB:  r[hi(a[0])] -= r[lo(a[0])]; break;
+                case OP_MUL:
+                    r[hi(a[0])] = static_cast<int32_t>((static_cast<int64_t>(r[hi(a[0])]) * r[lo(a[0])]) >> 8);
+                    break;
+                case OP_MOD: {
+                    int32_t m = r[lo(a[0])];
+                    int32_t& d = r[hi(a[0])];
+                    d = m > 0 ? ((d % m) + m) % m : 0;
+                    break;
+                }
+                case OP_ADDI: r[a[0]] += imm16(a + 1); break;
+                case OP_SHR:  r[a[0]] >>= a[1]; break;
+                case OP_TIME: {
+                    uint32_t period = static_cast<uint16_t>(imm16(a + 1));
+                    r[a[0]] = static_cast<int32_t>((static_cast<uint32_t>(time % period) << 16) / period);
+                    break;
+                }
+                case OP_SINE: r[a[0]] = Waveform::sine8(static_cast<uint16_t>(r[a[0]])); break;
+                case OP_TRI: {
+                    uint16_t phase = static_cast<uint16_t>(r[a[0]]);
+                    r[a[0]] = (phase < 32768 ? phase : 65535 - phase) >> 7;
+                    break;
+                }
+                case OP_KEYS: r[a[0]] = curve(a + 2, a[1], toByte(r[a[0]])); break;
+                case OP_LOOP:
+                    loops[depth++] = {pc, 0, loopCount(a[1], pixels), a[0]};
+                    r[a[0]] = 0;
+                    break;
+                case OP_NEXT: {
+                    Loop& loop = loops[depth - 1];
+                    if (++loop.index < loop.count) {
+                        r[loop.reg] = loop.index;
+                        pc = loop.start;
+                    } else {
+                        depth--;
+                    }
+                    break;
+                }
+                case OP_PIXEL:
+                    frame->setPixel(pixelAt(r[hi(a[0])], pixels),
+                                    Waveform::scale(color(a[1], scene), Waveform::fromByte(toByte(r[lo(a[0])]))));
+                    break;
+                case OP_BLEND: {
+                    Color from = color(hi(a[1]), scene);
+                    Color to = color(lo(a[1]), scene);
+                    Waveform::Level amount = Waveform::fromByte(toByte(r[lo(a[0])]));
+                    frame->setPixel(pixelAt(r[hi(a[0])], pixels), Color(Waveform::lerp8(from.r, to.r, amount),
+                                                                 Waveform::lerp8(from.g, to.g, amount),
+                                                                 Waveform::lerp8(from.b, to.b, amount)));
+                    break;
+                }
+                case OP_FILL:
+                    frame->fill(Waveform::scale(color(lo(a[0]), scene), Waveform::fromByte(toByte(r[hi(a[0])]))));
+                    break;
+            }
+        }
+        return true;                      // Unreachable for an analyzed program
+    }
+
+    [[nodiscard]] bool isLoaded() const { return length > 0; }
+    [[nodiscard]] const uint8_t* data() const { return bytes; }
+    [[nodiscard]] uint16_t getLength() const { return length; }
+    [[nodiscard]] uint16_t getSteps() const { return steps; }
+    [[nodiscard]] uint32_t getCrc() const { return crc; }
+};
+
+/**
+** ============================================================================
+** SCRIPT STORE - The uploaded program, in the sector below the settings ring
+** ============================================================================
+**
+** Uploads are rare, so the sector is simply erased and rewritten each time
+** (one erase, a few ms). A write torn by a power loss fails its CRC and
+** the lamp boots without a program: a scene that asks for the script then
+** shows its first color as a solid until the app uploads it again.
+**/
+class ScriptStore {
+private:
+    struct RecordHeader {
+        uint16_t magic;
+        uint16_t length;
+        uint32_t crc;                     // Of the program bytes
+    };
+
+    static constexpr uint16_t RECORD_MAGIC = 0x4353; // "SC"
+
+    union RecordBuffer {
+        uint32_t words[(sizeof(RecordHeader) + SCRIPT_MAX_SIZE + 3) / 4];
+        uint8_t bytes[sizeof(words)];
+        RecordHeader header;
+    };
+
+    static_assert(sizeof(RecordHeader) == 8, "RecordHeader must not contain padding");
+
+    static uint32_t sector() {
+        return (FS_PHYS_ADDR + FS_PHYS_SIZE) / SPI_FLASH_SEC_SIZE - SETTINGS_SECTORS - 1;
+    }
+
+public:
+    static bool load(ScriptProgram& program) {
+        RecordBuffer buffer;
+        if (!ESP.flashRead(sector() * SPI_FLASH_SEC_SIZE, buffer.words, sizeof(buffer.words))) return false;
+
+        const RecordHeader& header = buffer.header;
+        if (header.magic != RECORD_MAGIC || header.length > SCRIPT_MAX_SIZE) return false;
+
+        const uint8_t* code = buffer.bytes + sizeof(RecordHeader);
+        if (Crc32::compute(code, header.length) != header.crc) return false;
+        return program.load(code, header.length).result == Script::OK;
+    }
+
+    static bool save(const ScriptProgram& program) {
+        RecordBuffer buffer;
+        memset(buffer.bytes, 0xFF, sizeof(buffer.bytes));
+        buffer.header.magic = RECORD_MAGIC;
+        buffer.header.length = program.getLength();
+        buffer.header.crc = program.getCrc();
+        memcpy(buffer.bytes + sizeof(RecordHeader), program.data(), program.getLength());
+
+        return ESP.flashEraseSector(sector()) &&
+               ESP.flashWrite(sector() * SPI_FLASH_SEC_SIZE, buffer.words, sizeof(buffer.words));
+    }
+};
+
+#endif // ANIMATION_SCRIPT_H
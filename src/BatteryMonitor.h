@@ -0,0 +1,157 @@
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** BATTERY MONITOR - Oversampled, load-compensated state of charge
+** ============================================================================
+**
+** Every BATTERY_SAMPLE_INTERVAL a burst of BATTERY_OVERSAMPLE ADC readings
+** is taken, one per idle slot of the main loop (see
+** LuminaStateManager::idle()) and at least BATTERY_SAMPLE_SPACING apart.
+** That keeps each reading to a single ~100 us analogRead() and leaves the
+** ADC alone often enough for Wi-Fi. The burst sum is converted to
+** millivolts in integer math (16x oversampling adds two bits) and smoothed
+** by an exponential filter in 4-bit fixed point.
+**
+** A loaded cell reads low. The LED current reported with each reading
+** (FrameBuffer::getLoadMilliamps()) is converted to battery current through
+** the boost converter and multiplied by the cell's internal resistance. The
+** result is added back before the discharge curve is consulted, so the
+** percentage does not dip whenever the ring is bright.
+**/
+class BatteryMonitor {
+private:
+    struct CurvePoint {
+        uint16_t millivolts;
+        uint8_t percent;
+    };
+
+    // Resting 18650 discharge curve, highest voltage first
+    static constexpr CurvePoint CURVE[] PROGMEM = {
+        {4200, 100}, {4150, 95}, {4110, 90}, {4080, 85}, {4020, 80},
+        {3980, 75},  {3950, 70}, {3910, 65}, {3870, 60}, {3850, 55},
+        {3840, 50},  {3820, 45}, {3800, 40}, {3790, 35}, {3770, 30},
+        {3750, 25},  {3730, 20}, {3710, 15}, {3690, 10}, {3610, 5},
+        {3300, 2},   {3000, 0},
+    };
+    static constexpr size_t CURVE_POINTS = sizeof(CURVE) / sizeof(CURVE[0]);
+
+    // Full-scale ADC sum of one burst in battery millivolts:
+    // 1.0 V reference through the R1 = 330k / R2 = 100k divider
+    static constexpr uint32_t FULL_SCALE_MV = 1000UL * (BATTERY_DIVIDER_R1 + BATTERY_DIVIDER_R2) / BATTERY_DIVIDER_R2;
+    static constexpr uint32_t FULL_SCALE_SUM = 1023UL * BATTERY_OVERSAMPLE;
+
+    static_assert(FULL_SCALE_SUM * FULL_SCALE_MV < 0xFFFFFFFFUL / 2, "Burst sum would overflow");
+
+    uint32_t adcSum;
+    uint32_t loadSum;                     // LED mA summed over the burst
+    uint8_t samples;                      // Taken in the current burst
+    bool bursting;
+    unsigned long lastSample;
+
+    uint32_t filtered;                    // Millivolts << 4
+    bool hasReading;
+    uint16_t loadedMillivolts;            // Last burst, as measured
+    uint16_t millivolts;                  // Filtered, load-compensated
+    uint8_t percent;
+
+    static uint8_t curvePercent(uint16_t mv) {
+        if (mv >= pgm_read_word(&CURVE[0].millivolts)) return pgm_read_byte(&CURVE[0].percent);
+
+        for (size_t i = 1; i < CURVE_POINTS; i++) {
+            uint16_t lowMv = pgm_read_word(&CURVE[i].millivolts);
+            if (mv < lowMv) continue;
+
+            uint16_t highMv = pgm_read_word(&CURVE[i - 1].millivolts);
+            uint8_t low = pgm_read_byte(&CURVE[i].percent);
+            uint8_t high = pgm_read_byte(&CURVE[i - 1].percent);
+            return low + static_cast<uint8_t>(static_cast<uint32_t>(high - low) * (mv - lowMv) / (highMv - lowMv));
+        }
+        return 0;
+    }
+
+    // Voltage lost across the cell's internal resistance at this LED load
+    static uint16_t sagMillivolts(uint32_t ledMilliamps, uint16_t cellMv) {
+        if (cellMv == 0) return 0;
+        uint32_t batteryMa = BATTERY_SYSTEM_MA +
+                             ledMilliamps * LED_SUPPLY_MV * 100 / (static_cast<uint32_t>(cellMv) * BOOST_EFFICIENCY);
+        return static_cast<uint16_t>(batteryMa * BATTERY_INTERNAL_MOHM / 1000);
+    }
+
+    void finishBurst() {
+        bursting = false;
+
+        loadedMillivolts = static_cast<uint16_t>(adcSum * FULL_SCALE_MV / FULL_SCALE_SUM);
+        uint32_t load = loadSum / BATTERY_OVERSAMPLE;
+        uint32_t restingMv = loadedMillivolts + sagMillivolts(load, loadedMillivolts);
+
+        if (!hasReading) {
+            filtered = restingMv << 4;
+            hasReading = true;
+        } else {
+            // filtered += (sample - filtered) / 2^BATTERY_FILTER_SHIFT
+            int32_t delta = static_cast<int32_t>(restingMv << 4) - static_cast<int32_t>(filtered);
+            filtered = static_cast<uint32_t>(static_cast<int32_t>(filtered) + (delta >> BATTERY_FILTER_SHIFT));
+        }
+
+        millivolts = static_cast<uint16_t>(filtered >> 4);
+        percent = curvePercent(millivolts);
+    }
+
+public:
+    BatteryMonitor()
+        : adcSum(0),
+          loadSum(0),
+          samples(0),
+          bursting(false),
+          lastSample(0),
+          filtered(0),
+          hasReading(false),
+          loadedMillivolts(0),
+          millivolts(0),
+          percent(0) {}
+
+    /**
+     * Single reading at boot (~100 us), enough for the power budget of the
+     * first frames. The first full burst (started once boot is done) then
+     * replaces it rather than being filtered against it.
+     */
+    void begin(uint16_t ledMilliamps) {
+        adcSum = static_cast<uint32_t>(analogRead(BATTERY_PIN)) * BATTERY_OVERSAMPLE;
+        loadSum = static_cast<uint32_t>(ledMilliamps) * BATTERY_OVERSAMPLE;
+        finishBurst();
+        hasReading = false;
+    }
+
+    void startBurst() {
+        adcSum = 0;
+        loadSum = 0;
+        samples = 0;
+        bursting = true;
+    }
+
+    [[nodiscard]] bool wantsSample(unsigned long now) const {
+        return bursting && now - lastSample >= BATTERY_SAMPLE_SPACING;
+    }
+
+    // One ADC reading; ledMilliamps is the LED load while it was taken
+    void sample(uint16_t ledMilliamps) {
+        if (!bursting) return;
+
+        adcSum += analogRead(BATTERY_PIN);
+        loadSum += ledMilliamps;
+        lastSample = millis();
+        if (++samples >= BATTERY_OVERSAMPLE) finishBurst();
+    }
+
+    [[nodiscard]] uint16_t getMillivolts() const { return millivolts; }
+    [[nodiscard]] uint16_t getLoadedMillivolts() const { return loadedMillivolts; }
+    [[nodiscard]] float getVoltage() const { return millivolts / 1000.0f; }
+    [[nodiscard]] uint8_t getPercent() const { return percent; }
+};
+
+#endif // BATTERY_MONITOR_H
@@ -0,0 +1,69 @@
+#ifndef COMMAND_BATCH_H
+#define COMMAND_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+** ============================================================================
+** COMMAND BATCH - In-place reader for CMD_BATCH payloads
+** ============================================================================
+**
+** Payload layout: a sequence of length-prefixed sub-commands
+**   [len, cmd, data...] [len, cmd, data...] ...
+** where len counts the cmd byte plus its data (so len >= 1).
+**
+** Sub-commands are handed out as views into the receive buffer; nothing is
+** copied. validate() walks the whole payload first so a batch is applied
+** all-or-nothing: a truncated entry, a disallowed opcode or an entry too
+** short for its handler rejects it before any sub-command has run.
+**/
+struct SubCommand {
+    uint8_t cmd;
+    uint8_t* data;
+    size_t len;
+};
+
+class CommandBatch {
+private:
+    uint8_t* payload;
+    size_t length;
+    size_t offset;
+
+public:
+    CommandBatch(uint8_t* data, size_t len) : payload(data), length(len), offset(0) {}
+
+    // Advance to the next sub-command; false at the end of the payload
+    bool next(SubCommand& out) {
+        if (offset >= length) return false;
+
+        uint8_t entryLen = payload[offset];
+        if (entryLen == 0 || offset + 1 + entryLen > length) return false;
+
+        out.cmd = payload[offset + 1];
+        out.data = &payload[offset + 2];
+        out.len = entryLen - 1;
+        offset += 1 + entryLen;
+        return true;
+    }
+
+    /**
+     * Check that the payload is well formed, holds at least one and at most
+     * maxCommands entries, and that every entry passes `allowed` (given its
+     * opcode and data length).
+     */
+    static bool validate(uint8_t* data, size_t len, uint8_t maxCommands, bool (*allowed)(uint8_t cmd, size_t len)) {
+        CommandBatch batch(data, len);
+        SubCommand sub;
+        uint8_t count = 0;
+
+        while (batch.next(sub)) {
+            if (++count > maxCommands || !allowed(sub.cmd, sub.len)) return false;
+        }
+
+        // next() stops early on a truncated entry
+        return count > 0 && batch.offset == len;
+    }
+};
+
+#endif // COMMAND_BATCH_H
@@ -0,0 +1,76 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+** ============================================================================
+** COMMAND TABLE - Opcode dispatch shared by all states
+** ============================================================================
+**
+** Each state declares a constexpr table that maps opcodes to member
+** handlers, with the payload length each one needs at least:
+**
+**   static constexpr CommandHandler<ConnectedState> COMMANDS[] = {
+**       {CMD_SET_COLOR, 3, &ConnectedState::onSetColor},
+**       ...
+**   };
+**
+** and forwards handleCommand() to CommandTable::dispatch(). The length
+** check is done once, here, for every opcode; a handler only has to look at
+** optional trailing fields. The payload is passed as a view into the
+** shared packet buffer (see LuminaStateManager::receiveCommands()), not
+** a copy. Tables are a dozen entries at most, so a linear search beats a
+** 256-entry index on RAM and stays within a few cycles of a switch.
+**/
+struct CommandView {
+    uint8_t* data;                        // The bytes after the opcode
+    size_t len;
+
+    uint8_t operator[](size_t i) const { return data[i]; }
+
+    // Little-endian uint16 at offset, or fallback if the packet is shorter
+    [[nodiscard]] uint16_t u16(size_t offset, uint16_t fallback = 0) const {
+        return len >= offset + 2 ? static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8)) : fallback;
+    }
+
+    [[nodiscard]] uint32_t u32(size_t offset, uint32_t fallback = 0) const {
+        return len >= offset + 4 ? u16(offset) | (static_cast<uint32_t>(u16(offset + 2)) << 16) : fallback;
+    }
+};
+
+template <typename State>
+struct CommandHandler {
+    uint8_t cmd;
+    uint8_t minLength;                    // Payload bytes required
+    void (State::*handle)(CommandView payload);
+};
+
+namespace CommandTable {
+    enum Result : uint8_t {
+        HANDLED,
+        TOO_SHORT,                        // Known opcode, payload under minLength
+        UNKNOWN
+    };
+
+    template <typename State, size_t N>
+    [[nodiscard]] const CommandHandler<State>* find(const CommandHandler<State> (&table)[N], uint8_t cmd) {
+        for (const CommandHandler<State>& entry : table) {
+            if (entry.cmd == cmd) return &entry;
+        }
+        return nullptr;
+    }
+
+    template <typename State, size_t N>
+    Result dispatch(State* state, const CommandHandler<State> (&table)[N], uint8_t cmd, uint8_t* data, size_t len) {
+        const CommandHandler<State>* entry = find(table, cmd);
+        if (!entry) return UNKNOWN;
+        if (len < entry->minLength) return TOO_SHORT;
+
+        (state->*(entry->handle))(CommandView{data, len});
+        return HANDLED;
+    }
+}
+
+#endif // COMMAND_TABLE_H
@@ -4,8 +4,10 @@
 /**
  * Hardware Configuration
  */
-#define LED_PIN            D6        // WS2812B data pin
-#define LED_COUNT          16        // Number of LEDs in the ring
+#define LED_PIN            D6        // WS2812B data pin of strip 0 (bit-banged)
+#define LED_COUNT          16        // Default length of strip 0: the ring
+#define LED_STRIPS         2         // Strip 1 is on UART1 TX (GPIO2 / D4), see LedOutput.h
+#define LED_MAX            150       // Pixels across all strips (frame capacity)
 #define BATTERY_PIN        A0        // ADC for battery voltage monitoring
 
 // Power thresholds (18650 Li-ion: 4.2V full, 3.0V empty)
@@ -13,13 +15,57 @@
 #define BATTERY_EMPTY      3.0f
 #define BATTERY_WARNING    3.3f
 
+// Battery measurement (see BatteryMonitor.h)
+#define BATTERY_DIVIDER_R1 330       // Divider resistor to battery (kohm)
+#define BATTERY_DIVIDER_R2 100       // Divider resistor to ground (kohm)
+#define BATTERY_OVERSAMPLE 16        // ADC readings per burst (+2 bits)
+#define BATTERY_SAMPLE_SPACING 5     // Minimum gap between readings in a burst (ms)
+#define BATTERY_FILTER_SHIFT 2       // Smoothing across bursts: new = old + (x - old) / 4
+#define BATTERY_INTERNAL_MOHM 150    // Cell + wiring resistance for sag compensation (mohm)
+#define BATTERY_SYSTEM_MA  80        // ESP8266 draw from the cell with the radio on (mA)
+
+// LED load model (WS2812B behind the MT3608 boost converter)
+#define LED_SUPPLY_MV      5000      // Boost converter output (mV)
+#define BOOST_EFFICIENCY   85        // Boost converter efficiency (%)
+#define LED_CHANNEL_MA     20        // One color channel at full duty (mA)
+#define LED_IDLE_MA        1         // One LED's driver with all channels off (mA)
+
+// LED current budget (see PowerGovernor.h)
+#define POWER_BUDGET_MAX   800       // Default budget with a healthy battery (mA)
+#define POWER_BUDGET_MIN   150       // Budget on an empty battery (mA)
+#define POWER_DERATE_PERCENT 30      // Start derating below this state of charge (%)
+
 
 /**
  * Network Configuration
  */
 #define UDP_PORT           4210      // Device listens on this port
-#define HEARTBEAT_INTERVAL 5000      // Send status every 5 seconds (ms)
-#define WIFI_TIMEOUT       30000     // 30 seconds to connect
+#define GROUP_MULTICAST_IP 239, 255, 42, 10 // Joined on UDP_PORT too: one packet reaches every lamp
+#define GROUP_COUNT        32        // Group IDs 1-32 (CMD_GROUP); 0 addresses every lamp
+#define UDP_BATCH_BUDGET   16        // Max datagrams drained per loop iteration
+#define UDP_POLL_INTERVAL  5         // Command intake poll interval (ms)
+#define HEARTBEAT_INTERVAL_MIN  1000   // Heartbeat interval right after a change (ms)
+#define HEARTBEAT_INTERVAL_MAX  30000  // Heartbeat interval once stable (ms)
+#define HEARTBEAT_FULL_INTERVAL 60000  // Send a full status snapshot at least this often (ms)
+#define HEARTBEAT_RSSI_HYSTERESIS 6    // RSSI change (dB) that counts as a change
+#define CLOCK_SOURCE_TIMEOUT 90000   // Lead once the followed clock is silent this long (ms)
+#define CLOCK_STEP_THRESHOLD 250     // Jump instead of slewing when off by more than this (ms)
+#define CLOCK_SLEW_DIVISOR 10        // Slew the shared clock by at most 1 ms per this many ms
+#define CLOCK_DRIFT_SPAN   60000     // Shortest span a drift measurement is taken over (ms)
+#define CLOCK_MAX_DRIFT_PPM 200      // Larger measured drift is clamped (crystals: ~20 ppm)
+#define WIFI_TIMEOUT       30000     // Search at least this long before provisioning (ms)
+#define WIFI_POLL_INTERVAL 50        // Connection status poll while searching (ms)
+#define FAST_RECONNECT_TIMEOUT 3000  // Give up on the cached BSSID/channel after this (ms)
+#define FAST_RECONNECT_STATIC_IP false // Reuse the last DHCP lease as a static IP (reserved leases only)
+#define WIFI_NETWORKS      4         // Stored networks, most recently used first
+#define WIFI_ATTEMPT_TIMEOUT 6000    // Move on to the next access point after this (ms)
+#define SCAN_POLL_INTERVAL 100       // Async scan completion poll (ms)
+#define SCAN_MAX_CANDIDATES 8        // Known access points kept from a scan, strongest first
+#define SCAN_CACHE_TTL     60000     // Connect from the last scan this long before rescanning (ms)
+#define SCAN_RETRY_DELAY   8000      // With nothing known in range, scan again after this (ms)
+#define MAX_SUBSCRIBERS    4         // Unicast status subscribers (CMD_SUBSCRIBE)
+#define SUBSCRIBER_DEFAULT_LEASE 120 // Lease when the command gives none (s)
+#define SUBSCRIBER_MAX_LEASE 600     // Longest lease a subscriber can request (s)
 #define AP_SSID            "Lumina-Setup"
 #define AP_PASSWORD        "lumina2026"
 
@@ -28,16 +74,71 @@
  */
 #define SEARCHING_DURATION 30000     // Pulse blue for 30 seconds
 #define PROVISION_TIMEOUT  300000    // 5 minutes in AP mode
-#define HEARTBEAT_TIMEOUT  10000     // Consider disconnected after 10 seconds
+#define HEARTBEAT_TIMEOUT  65000     // Consider disconnected after 2 max heartbeat intervals
+#define CONNECTION_CHECK_INTERVAL 5000 // Wi-Fi link check while connected (ms)
+
+// Low-power mode while a static scene is showing (see ConnectedState::updatePowerMode)
+#define LOW_POWER_IDLE_DELAY 3000    // Quiet time after the last command before sleeping (ms)
+#define LOW_POWER_CHECK_INTERVAL 500 // How often the sleep conditions are re-evaluated (ms)
+#define LOW_POWER_POLL_INTERVAL 50   // Command intake poll while sleeping (ms)
+#define LOW_POWER_LISTEN_INTERVAL 0  // Beacons between radio wakeups; 0 = the AP's DTIM period
+#define REBOOT_DELAY       500       // Let replies and log output drain before restarting (ms)
+
+// Pull OTA over HTTP(S) (CMD_OTA_START with a URL, see FirmwareDownload.h)
+#define OTA_URL_MAX        160       // Longest accepted image URL
+#define OTA_CHUNK_SIZE     1024      // Bytes moved from the socket to flash per poll
+#define OTA_POLL_INTERVAL  2         // Download poll interval (ms)
+#define OTA_HTTP_TIMEOUT   5000      // Connect/header timeout per attempt (ms)
+#define OTA_STALL_TIMEOUT  15000     // Reconnect if no data arrives for this long (ms)
+#define OTA_RETRY_DELAY    3000      // Wait before resuming after a failed attempt (ms)
+#define OTA_MAX_RETRIES    10        // Consecutive failed attempts before giving up
+#define OTA_TLS_RX_BUFFER  16384     // BearSSL receive buffer (servers rarely do MFLN)
+#define OTA_IDLE_TIMEOUT   600000    // Leave the updating state after this long without progress (ms)
+
+// Multicast OTA (CMD_OTA_MULTICAST, see MulticastImage.h)
+#define OTA_MC_CHUNK_SIZE  1024      // Image bytes per datagram; divides the flash sector
+#define OTA_MC_MAX_CHUNKS  1024      // Largest image: 1 MB
+#define OTA_MC_QUIET_TIME  1500      // No new chunk for this long: NACK the gaps (ms)
+#define OTA_MC_NACK_INTERVAL 1000    // Repeat a NACK while chunks are missing (ms)
+#define OTA_MC_NACK_JITTER 300       // Random extra NACK delay so lamps don't collide (ms)
+#define OTA_MC_NACK_MAX    32        // Chunk indices per NACK
+#define OTA_MC_DATA        0x01      // Packet types on the group / to the sender
+#define OTA_MC_END         0x02
+#define OTA_MC_NACK        0x03
+#define OTA_MC_DONE        0x04
+
+/**
+ * Scheduler Configuration
+ */
+#define SCHEDULER_MAX_TASKS 16       // Task table size (manager + active state)
+#define SCHEDULER_MAX_IDLE  100      // Longest single idle sleep in loop() (ms)
 
 
 /**
  * Memory Management
  */
 #define MIN_FREE_HEAP      8192      // Minimum free heap before warning
-#define EEPROM_SIZE        512       // EEPROM allocation for credentials
+#define MIN_FREE_BLOCK     4096      // Largest free block before a fragmentation warning
+#define HEAP_CHECK_INTERVAL 30000    // Memory leak check interval (ms)
+#define BATTERY_SAMPLE_INTERVAL 10000 // Battery reading interval (ms)
+#define BOOT_DEFER_TIMEOUT 15000     // Deferred start-up work runs by now even without Wi-Fi (ms)
+
+// Settings store (see SettingsStore.h)
+#define SETTINGS_VERSION   6         // Bump when Settings gains fields
+#define SETTINGS_SECTORS   4         // Flash sectors in the record ring
+#define SETTINGS_SLOT_SIZE 512       // Bytes per record slot (8 per sector)
+#define SETTINGS_LEGACY_SLOT_SIZE 256 // Slot size before settings version 4
+#define SETTINGS_WRITE_DELAY 2000    // Debounce: write once changes stop for this long (ms)
+#define SETTINGS_MAX_WRITE_DELAY 10000 // ...but never hold a change longer than this (ms)
 
-// EEPROM Memory Map
+// Animation scripts (see AnimationScript.h)
+#define SCRIPT_MAX_SIZE    240       // Program bytes; one CMD_SCRIPT packet
+#define SCRIPT_STEP_BUDGET 1024      // Instructions per frame, checked at upload and while running
+#define SCRIPT_MAX_DEPTH   2         // Nested LOOPs
+#define SCRIPT_MAX_KEYS    8         // Keyframes per KEYS curve
+
+// Legacy EEPROM map (firmware <= 1.0.0), read once to import credentials
+#define EEPROM_SIZE        512       // EEPROM allocation for credentials
 #define EEPROM_MAGIC       0xA5      // Magic byte to verify valid data
 #define ADDR_MAGIC         0         // Magic byte address
 #define ADDR_SSID_LEN      1         // SSID length (1 byte)
@@ -50,8 +151,10 @@
  */
 #define PULSE_SPEED        50        // Animation update interval (ms)
 #define FADE_SPEED         20        // Color transition speed (ms)
+#define STATIC_RENDER_INTERVAL 250   // Render interval while the scene cannot change by itself (ms)
 #define BRIGHTNESS_MAX     200       // Max brightness (0-255)
 #define BRIGHTNESS_MIN     10        // Min brightness for pulse
+#define BOOT_ANIMATION     true      // Rainbow at power-on (skipped when a scene is restored)
 
 /**
  * Communication Protocol
@@ -63,21 +166,57 @@
 #define CMD_GET_STATUS     0x04      // Request device status
 #define CMD_PROVISION      0x05      // Send Wi-Fi credentials
 #define CMD_OTA_START      0x06      // Begin OTA update
+#define CMD_SUBSCRIBE      0x07      // Lease unicast status: [leaseSec u16, port u16]
+#define CMD_BATCH          0x08      // Several commands applied atomically: [len, cmd, data...]*
+#define BATCH_MAX_COMMANDS 16        // Sub-commands accepted in one CMD_BATCH
+#define CMD_FRAME          0x09      // Live pixel frame: [seq u16, R, G, B x pixels]
+#define CMD_OTA_MULTICAST  0x0A      // Join a multicast rollout: [group x4, port u16, session u16, size u32, sha256 x32]
+#define CMD_SET_POWER_BUDGET 0x0B    // LED current budget: [mA u16], 0 = default
+#define CMD_GET_PROFILE    0x0C      // Hot-path timings: [flags]; bit 0 resets them after the reply
+#define CMD_SYNC_CLOCK     0x0D      // App time base for grouped animations: [ms u32]
+#define CMD_GROUP          0x0E      // Command for one group only: [group, cmd, data...]
+#define CMD_GROUPS         0x0F      // Set group membership: [mask u32] (bit n-1 = group n); empty = query
+#define CMD_SCRIPT         0x20      // Store an animation program: [program...] (0x10-0x1F are status codes)
+#define CMD_SET_STRIPS     0x21      // Strip lengths: [len u16 x LED_STRIPS]; empty = query
+#define LIVE_FRAME_TIMEOUT 1000      // Resume the strategy after this long without frames (ms)
 #define CMD_RESET          0xFF      // Factory reset
 
 // Status Types (1 byte)
-#define STATUS_HEARTBEAT   0x10      // Regular status broadcast
+#define STATUS_HEARTBEAT   0x10      // Legacy v1 status broadcast (no longer sent)
 #define STATUS_BATTERY     0x11      // Battery level update
 #define STATUS_ERROR       0x12      // Error notification
 #define STATUS_STATE       0x13      // State change notification
+#define STATUS_HEARTBEAT_V2 0x14     // Delta-encoded status (see Heartbeat.h)
+#define HEARTBEAT_VERSION  2
+#define STATUS_PROFILE     0x15      // Reply to CMD_GET_PROFILE (see Profiler.h)
+#define STATUS_GROUPS      0x16      // Reply to CMD_GROUPS: [mask u32]
+#define STATUS_SCRIPT      0x17      // Reply to CMD_SCRIPT: [result, offset u16, steps u16, crc u32]
+#define STATUS_STRIPS      0x18      // Reply to CMD_SET_STRIPS: [strips, len u16 x strips]
+#define PROFILE_VERSION    2         // 2: boot timeline after the sections
+
+// Lighting strategy IDs (reported in heartbeats; all but 3-4 match CMD_SET_MOOD types)
+#define STRATEGY_CALM      0x00
+#define STRATEGY_FOCUS     0x01
+#define STRATEGY_PARTY     0x02
+#define STRATEGY_SOLID     0x03
+#define STRATEGY_LIVE      0x04      // Streaming CMD_FRAME pixels
+#define STRATEGY_SCRIPT    0x05      // The stored CMD_SCRIPT program (CMD_SET_MOOD type 5)
+#define STRATEGY_GRADIENT  0x06      // Three colors blended around the ring
+#define GRADIENT_PERIOD    12000     // One turn of the gradient (ms)
 
 
 /**
  * Debug Settings
  */
+#ifndef DEBUG_MODE                    // -DDEBUG_MODE=false in the production/native builds
 #define DEBUG_MODE         true      // Enable serial debugging
+#endif
 #define SERIAL_BAUD        115200    // Serial monitor baud rate
 
+#ifndef PROFILE_ENABLED                  // -DPROFILE_ENABLED=0 compiles the probes out
+#define PROFILE_ENABLED    1         // Cycle-count probes on the hot paths (Profiler.h)
+#endif
+
 #if DEBUG_MODE
   #define DEBUG_PRINT(x)   Serial.print(x)
   #define DEBUG_PRINTLN(x) Serial.println(x)
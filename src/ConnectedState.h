@@ -5,184 +5,497 @@
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
 #include "Config.h"
+#include "AnimationScript.h"
+#include "CommandBatch.h"
+#include "CommandTable.h"
+#include "EffectSequence.h"
+#include "FirmwareDownload.h"
+#include "FrameBuffer.h"
+#include "Heartbeat.h"
+#include "LightingEngine.h"
+#include "MulticastImage.h"
+#include "NetworkClock.h"
+#include "PacketIntake.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "Scheduler.h"
+#include "SubscriberTable.h"
 #include "UpdatingState.h"
 #include "SearchingState.h"
 
 
-/**
- * Lighting Strategies (Strategy Pattern)
- */
-class LightingStrategy {
-public:
-    virtual ~LightingStrategy() = default;
-    virtual void apply(Adafruit_NeoPixel* leds, unsigned long time) = 0;
-    [[nodiscard]] virtual const char* getName() const = 0;
-};
-
-class SolidColorStrategy : public LightingStrategy {
+// ============================================================================
+// CONNECTED STATE - Normal operation mode
+// ============================================================================
+class ConnectedState : public LuminaState {
 private:
-    Color color;
+    WiFiUDP udp;
+    HeartbeatEncoder heartbeat;
+    Scheduler::TaskId heartbeatTask;
     
-public:
-    explicit SolidColorStrategy(Color c) : color(c) {}
+    // Color/brightness commands are held until the end of an intake batch so
+    // that only the latest one is applied ("latest wins")
+    bool pendingColorSet;
+    Color pendingColor;
+    uint16_t pendingColorFade;
+    bool pendingBrightnessSet;
+    uint8_t pendingBrightness;
+    uint16_t coalescedCommands;
+    IntakeStats intakeTotals;
+    
+    // Live frame streaming (CMD_FRAME): pixels land directly in the frame
+    // buffer and the lighting engine is paused until the stream goes quiet
+    bool liveStreaming;
+    bool liveFrameReceived;               // A frame arrived in this intake batch
+    uint16_t liveSequence;
+    unsigned long lastLiveFrame;
+    uint32_t staleFrames;
+    
+    // Low power: while a static scene shows and the app is quiet, the radio
+    // sleeps between DTIM beacons and intake polls less often
+    Scheduler::TaskId intakeTask;
+    bool lowPower;
+    unsigned long lastCommand;
+    uint8_t peerHeartbeats;               // In this intake batch; they don't count as activity
+    
+    HeartbeatSnapshot captureStatus() {
+        HeartbeatSnapshot status;
+        status.state = STATE_CONNECTED;
+        status.batteryPercent = manager->getBatteryPercent();
+        status.batteryMillivolts = static_cast<uint16_t>(manager->getBatteryVoltage() * 1000.0f);
+        status.rssi = static_cast<int8_t>(WiFi.RSSI());
+        status.strategyId = liveStreaming ? STRATEGY_LIVE
+                          : manager->getLighting()->getScene().strategyId;
+        status.brightness = manager->getFrameBuffer()->getBrightness();
+        status.freeHeap = manager->getFreeHeap();
+        
+        NetworkClock* clock = manager->getClock();
+        status.clockTime = clock->now(millis());
+        status.clockRank = clock->getRank();
+        return status;
+    }
+    
+    // replyToSender: also unicast to the sender of the command being handled
+    // if it is not a subscriber (otherwise the reply only reaches subscribers)
+    void sendHeartbeat(bool fullSnapshot = false, bool replyToSender = false) {
+        PROFILE_SCOPE(manager->getProfiler(), PROFILE_HEARTBEAT);
+        HeartbeatSnapshot status = captureStatus();
+        
+        uint8_t packet[HB_MAX_PACKET_SIZE];
+        size_t len = heartbeat.encode(status, fullSnapshot, millis(), packet);
+        
+        // Unicast to subscribers (broadcast if there are none)
+        manager->sendUDP(packet, len);
+        
+        SubscriberTable* table = manager->getSubscribers();
+        if (table->expire(millis()) > 0) {
+            // The broadcast also carried our clock to the other lamps; without
+            // it they get the clock alone, on the group address
+            uint8_t beat[HB_LIVENESS_SIZE];
+            size_t beatLen = HeartbeatEncoder::encodeLiveness(status, heartbeat.getSequence() - 1, beat);
+            manager->sendUDPTo(IPAddress(GROUP_MULTICAST_IP), UDP_PORT, beat, beatLen);
+            
+            if (replyToSender && !table->contains(udp.remoteIP(), udp.remotePort())) {
+                manager->sendUDPTo(udp.remoteIP(), udp.remotePort(), packet, len);
+            }
+        }
+        
+        // Adapt the rate: fast after changes, backing off while stable
+        manager->getScheduler()->setPeriod(heartbeatTask, heartbeat.getInterval());
+        
+        DEBUG_PRINTF("[CONNECTED] ♥ Heartbeat #%u | %u bytes | Next in %lu ms\n",
+                    heartbeat.getSequence() - 1, len, heartbeat.getInterval());
+        DEBUG_PRINTF("[CONNECTED]   Battery: %d%% | Heap: %d | RSSI: %d | Skipped frames: %u\n", 
+                    status.batteryPercent, status.freeHeap, status.rssi,
+                    manager->getFrameBuffer()->getSkippedFrames());
+        DEBUG_PRINTF("[CONNECTED]   Packets: %u received, %u coalesced, %u dropped | Stale frames: %u\n",
+                    intakeTotals.received, intakeTotals.coalesced, intakeTotals.dropped, staleFrames);
+    }
+    
+    // Pull the next heartbeat in so a scene change is reported promptly
+    void heartbeatSoon() {
+        if (heartbeat.getInterval() <= HEARTBEAT_INTERVAL_MIN) return;
+        heartbeat.noteChange();
+        manager->getScheduler()->setPeriod(heartbeatTask, HEARTBEAT_INTERVAL_MIN);
+    }
     
-    void apply(Adafruit_NeoPixel* leds, unsigned long time) override {
-        for (int i = 0; i < LED_COUNT; i++) {
-            leds->setPixelColor(i, color.to32bit());
+    void checkConnection() {
+        if (WiFi.status() != WL_CONNECTED) {
+            DEBUG_PRINTLN("[CONNECTED] ✗ WiFi lost, returning to search");
+            manager->transitionTo(createSearchingState(manager));
         }
-        leds->show();
     }
     
-    [[nodiscard]] const char* getName() const override { return "Solid"; }
-};
-
-class CalmBreathingStrategy : public LightingStrategy {
-private:
-    Color baseColor;
+    // Hand the ring back to the lighting engine (any scene command also ends a stream)
+    void stopLiveStream() {
+        if (!liveStreaming) return;
+        liveStreaming = false;
+        liveFrameReceived = false;
+        manager->getLighting()->setActive(true);
+        heartbeatSoon();
+    }
     
-public:
-    explicit CalmBreathingStrategy(Color c) : baseColor(c) {}
+    void showScene(const Scene& scene, uint16_t fadeMs) {
+        stopLiveStream();
+        manager->applyScene(scene, fadeMs);
+        heartbeatSoon();
+    }
+    
+    // Apply coalesced color/brightness commands; called at the end of each
+    // intake batch and before any command that must observe them in order
+    void applyPendingCommands() {
+        if (pendingColorSet) {
+            pendingColorSet = false;
+            showScene(Scene::of(STRATEGY_SOLID, pendingColor), pendingColorFade);
+            DEBUG_PRINTF("[CONNECTED] Set color: RGB(%d,%d,%d) over %u ms\n", 
+                       pendingColor.r, pendingColor.g, pendingColor.b, pendingColorFade);
+        }
+        
+        if (pendingBrightnessSet) {
+            pendingBrightnessSet = false;
+            manager->applyBrightness(pendingBrightness);
+            DEBUG_PRINTF("[CONNECTED] Brightness: %d\n", pendingBrightness);
+            heartbeatSoon();
+        }
+    }
     
-    void apply(Adafruit_NeoPixel* leds, unsigned long time) override {
-        // Slow sine wave breathing (4-second cycle)
-        auto phase = static_cast<float>((time % 4000) / 4000.0 * 2.0 * PI);
-        auto brightness = static_cast<float>((sin(phase) + 1.0) / 2.0); // 0.0 to 1.0
+    // Scene commands only: anything that could change state mid-batch would
+    // break the all-or-nothing guarantee. The length is checked here too, so
+    // no entry can fail with TOO_SHORT once the batch is applying
+    static bool isBatchable(uint8_t cmd, size_t len) {
+        if (cmd != CMD_SET_COLOR && cmd != CMD_SET_MOOD && cmd != CMD_SET_BRIGHTNESS) return false;
         
-        auto r = static_cast<uint8_t>(static_cast<float>(baseColor.r) * brightness);
-        auto g = static_cast<uint8_t>(static_cast<float>(baseColor.g) * brightness);
-        auto b = static_cast<uint8_t>(static_cast<float>(baseColor.b) * brightness);
+        const CommandHandler<ConnectedState>* entry = CommandTable::find(COMMANDS, cmd);
+        return entry && len >= entry->minLength;
+    }
+    
+    // Apply every sub-command before the next frame is rendered
+    void applyBatch(uint8_t* data, size_t len) {
+        if (!CommandBatch::validate(data, len, BATCH_MAX_COMMANDS, isBatchable)) {
+            DEBUG_PRINTLN("[CONNECTED] ✗ Rejected malformed batch");
+            return;
+        }
         
-        for (int i = 0; i < LED_COUNT; i++) {
-            leds->setPixelColor(i, r, g, b);
+        CommandBatch batch(data, len);
+        SubCommand sub;
+        while (batch.next(sub)) {
+            handleCommand(sub.cmd, sub.data, sub.len);
         }
-        leds->show();
     }
     
-    [[nodiscard]] const char* getName() const override { return "Calm"; }
-};
-
-class FocusStrategy : public LightingStrategy {
-private:
-    Color color;
+    void setLowPower(bool enabled) {
+        lowPower = enabled;
+        manager->getScheduler()->setPeriod(intakeTask, enabled ? LOW_POWER_POLL_INTERVAL : UDP_POLL_INTERVAL);
+        manager->setLowPower(enabled);
+    }
     
-public:
-    explicit FocusStrategy(Color c) : color(c) {}
+    // Sleep only when nothing needs to happen between scheduler deadlines:
+    // the frame cannot change by itself and no one has talked to us lately
+    void updatePowerMode() {
+        bool quiet = manager->getLighting()->isStatic() &&
+                     !manager->getEffects()->isPlaying() &&
+                     !liveStreaming &&
+                     millis() - lastCommand >= LOW_POWER_IDLE_DELAY;
+        if (quiet != lowPower) setLowPower(quiet);
+    }
     
-    void apply(Adafruit_NeoPixel* leds, unsigned long time) override {
-        // Steady light with subtle pulsing (slower than calm)
-        auto phase = static_cast<float>((time % 8000) / 8000.0 * 2.0 * PI);
-        auto brightness = static_cast<float>(0.7 + 0.3 * ((sin(phase) + 1.0) / 2.0)); // 0.7 to 1.0
-
-        auto r = static_cast<uint8_t>(static_cast<float>(color.r) * brightness);
-        auto g = static_cast<uint8_t>(static_cast<float>(color.g) * brightness);
-        auto b = static_cast<uint8_t>(static_cast<float>(color.b) * brightness);
-
-        for (int i = 0; i < LED_COUNT; i++) {
-            leds->setPixelColor(i, r, g, b);
+    void receiveCommands() {
+        coalescedCommands = 0;
+        peerHeartbeats = 0;
+        IntakeStats batch = manager->receiveCommands(udp);
+        if (manager->getCurrentState() != this) return; // A command moved us on
+        
+        // Wake at once, so follow-up commands aren't held for a DTIM interval
+        if (batch.received > peerHeartbeats) {
+            lastCommand = millis();
+            if (lowPower) setLowPower(false);
+        }
+        
+        applyPendingCommands();
+        
+        // Only the newest streamed frame of a batch is pushed to the strip
+        if (liveFrameReceived) {
+            liveFrameReceived = false;
+            manager->getFrameBuffer()->show();
+        } else if (liveStreaming && millis() - lastLiveFrame >= LIVE_FRAME_TIMEOUT) {
+            DEBUG_PRINTLN("[CONNECTED] Live stream stopped, resuming scene");
+            stopLiveStream();
+        }
+        
+        batch.coalesced = coalescedCommands;
+        intakeTotals.accumulate(batch);
+        
+        if (batch.coalesced > 0 || batch.dropped > 0) {
+            DEBUG_PRINTF("[CONNECTED] Batch: %u received, %u coalesced, %u dropped\n",
+                       batch.received, batch.coalesced, batch.dropped);
         }
-        leds->show();
     }
     
-    [[nodiscard]] const char* getName() const override { return "Focus"; }
-};
+    void warnLowBattery() {
+        float voltage = manager->getBatteryVoltage();
+        if (voltage < BATTERY_WARNING && voltage > BATTERY_EMPTY) {
+            DEBUG_PRINTF("[CONNECTED] ⚠ Low battery: %.2fV\n", voltage);
+        }
+    }
 
-class PartyStrategy : public LightingStrategy {
-private:
-    Color color1, color2, color3;
+    // ========================================================================
+    // COMMAND HANDLERS - payload lengths are checked against COMMANDS first
+    // ========================================================================
+    void onSetColor(CommandView payload) {
+        if (pendingColorSet) coalescedCommands++;
+        pendingColorSet = true;
+        pendingColor = Color(payload[0], payload[1], payload[2]);
+        pendingColorFade = payload.u16(3);
+    }
     
-public:
-    PartyStrategy(const Color c1, const Color c2, const Color c3)
-        : color1(c1), color2(c2), color3(c3) {}
+    // Moods with three colors: [type, RGB, (RGB, RGB, fade u16) | (fade u16)]
+    void showColors(uint8_t strategyId, CommandView payload, const Color& c2, const Color& c3) {
+        Color c1(payload[1], payload[2], payload[3]);
+        if (payload.len >= 10) {
+            Color custom2(payload[4], payload[5], payload[6]);
+            Color custom3(payload[7], payload[8], payload[9]);
+            showScene(Scene::of(strategyId, c1, custom2, custom3), payload.u16(10));
+        } else {
+            showScene(Scene::of(strategyId, c1, c2, c3), payload.u16(4));
+        }
+    }
     
-    void apply(Adafruit_NeoPixel* leds, unsigned long time) override {
-        // Rotating rainbow segments
-        int offset = static_cast<int>((time / 50) % LED_COUNT);
+    void onSetMood(CommandView payload) {
+        uint8_t moodType = payload[0];
+        Color color(payload[1], payload[2], payload[3]);
+        uint16_t fadeMs = payload.u16(4);
         
-        for (int i = 0; i < LED_COUNT; i++) {
-            int pos = (i + offset) % LED_COUNT;
-            Color c;
-            
-            if (pos < LED_COUNT / 3) c = color1;
-            else if (pos < 2 * LED_COUNT / 3) c = color2;
-            else c = color3;
-            
-            leds->setPixelColor(i, c.to32bit());
+        switch (moodType) {
+            case 0: // Calm
+                showScene(Scene::of(STRATEGY_CALM, color), fadeMs);
+                DEBUG_PRINTLN("[CONNECTED] Mood: Calm");
+                break;
+            case 1: // Focus
+                showScene(Scene::of(STRATEGY_FOCUS, color), fadeMs);
+                DEBUG_PRINTLN("[CONNECTED] Mood: Focus");
+                break;
+            case 2: // Party
+                showColors(STRATEGY_PARTY, payload, Colors::CONNECTED, Colors::SEARCHING);
+                DEBUG_PRINTLN("[CONNECTED] Mood: Party");
+                break;
+            case 5: // Script uploaded with CMD_SCRIPT; the colors are its parameters
+                showColors(STRATEGY_SCRIPT, payload, Colors::OFF, Colors::OFF);
+                DEBUG_PRINTLN("[CONNECTED] Mood: Script");
+                break;
+            case 6: // Gradient
+                showColors(STRATEGY_GRADIENT, payload, Colors::OFF, Colors::OFF);
+                DEBUG_PRINTLN("[CONNECTED] Mood: Gradient");
+                break;
+            default:
+                showScene(Scene::of(STRATEGY_SOLID, color), fadeMs);
+                break;
         }
-        leds->show();
     }
     
-    [[nodiscard]] const char* getName() const override { return "Party"; }
-};
-
-// ============================================================================
-// CONNECTED STATE - Normal operation mode
-// ============================================================================
-class ConnectedState : public LuminaState {
-private:
-    WiFiUDP udp;
-    LightingStrategy* currentStrategy;
-    unsigned long lastHeartbeat;
-    unsigned long lastStrategyUpdate;
-    unsigned long connectionCheckTime;
-    
-    void sendHeartbeat() {
-        if (millis() - lastHeartbeat < HEARTBEAT_INTERVAL) return;
-        lastHeartbeat = millis();
-        
-        // Build status packet
-        uint8_t packet[32];
-        packet[0] = STATUS_HEARTBEAT;
-        packet[1] = STATE_CONNECTED;
-        packet[2] = manager->getBatteryPercent();
-        packet[3] = static_cast<uint8_t>(WiFi.RSSI() + 128); // Convert -128..0 to 0..128
+    void onSetBrightness(CommandView payload) {
+        if (pendingBrightnessSet) coalescedCommands++;
+        pendingBrightnessSet = true;
+        pendingBrightness = payload[0];
+    }
+    
+    void onBatch(CommandView payload) {
+        applyBatch(payload.data, payload.len);
+    }
+    
+    void onFrame(CommandView) {
+        // Well-formed frames never get here (see receiveDirect())
+        DEBUG_PRINTF("[CONNECTED] ✗ Frame must carry %d pixels\n", manager->getFrameBuffer()->length());
+    }
+    
+    void onGetStatus(CommandView) {
+        sendHeartbeat(true, true);        // Send an immediate full snapshot
+    }
+    
+    void onSubscribe(CommandView payload) {
+        uint16_t lease = payload.u16(0, SUBSCRIBER_DEFAULT_LEASE);
+        uint16_t port = payload.u16(2, udp.remotePort());
         
-        float voltage = manager->getBatteryVoltage();
-        memcpy(&packet[4], &voltage, sizeof(float));
+        manager->getSubscribers()->subscribe(udp.remoteIP(), port, lease);
+        if (lease > 0) sendHeartbeat(true); // Start the subscriber off with a snapshot
+    }
+    
+    void onGetProfile(CommandView payload) {
+        Profiler* profiler = manager->getProfiler();
+        uint8_t packet[Profiler::PACKET_SIZE];
+        size_t packetLen = profiler->encode(packet);
+        manager->sendUDPTo(udp.remoteIP(), udp.remotePort(), packet, packetLen);
         
-        uint32_t heap = manager->getFreeHeap();
-        memcpy(&packet[8], &heap, sizeof(uint32_t));
+        if (payload.len >= 1 && (payload[0] & 0x01)) profiler->reset();
+    }
+    
+    void onSetPowerBudget(CommandView payload) {
+        manager->applyPowerBudget(payload.u16(0));
+    }
+    
+    void onOtaStart(CommandView payload) {
+        if (payload.len == 0) {
+            DEBUG_PRINTLN("[CONNECTED] OTA update requested");
+            manager->transitionTo(createUpdatingState(manager));
+            return;
+        }
         
-        // Strategy name
-        const char* name = currentStrategy->getName();
-        packet[12] = strlen(name);
-        memcpy(&packet[13], name, packet[12]);
+        OtaRequest request;
+        if (!request.parse(payload.data, payload.len)) {
+            DEBUG_PRINTLN("[CONNECTED] ✗ Invalid OTA request");
+            return;
+        }
+        DEBUG_PRINTLN("[CONNECTED] Pull OTA update requested");
+        manager->transitionTo(createUpdatingState(manager, &request));
+    }
+    
+    void onOtaMulticast(CommandView payload) {
+        MulticastOffer offer;
+        if (!offer.parse(payload.data, payload.len)) {
+            DEBUG_PRINTLN("[CONNECTED] ✗ Invalid multicast OTA offer");
+            return;
+        }
+        DEBUG_PRINTLN("[CONNECTED] Multicast OTA update requested");
+        manager->transitionTo(createMulticastUpdatingState(manager, offer));
+    }
+    
+    void onSyncClock(CommandView payload) {
+        manager->getClock()->observe(payload.u32(0), NetworkClock::APP_RANK, millis());
+    }
+    
+    // Another lamp's broadcast heartbeat: only its clock is of interest
+    void onPeerHeartbeat(CommandView payload) {
+        peerHeartbeats++;
         
-        // Broadcast heartbeat
-        IPAddress broadcast = WiFi.localIP();
-        broadcast[3] = 255; // Make it broadcast
+        uint32_t time, rank;
+        if (HeartbeatEncoder::readClock(payload.data, payload.len, time, rank)) {
+            manager->getClock()->observe(time, rank, millis());
+        }
+    }
+    
+    // [group, cmd, data...]: run the wrapped command if we are in the group
+    void onGroup(CommandView payload) {
+        uint8_t group = payload[0];
+        bool member = group == 0 ||
+                      (group <= GROUP_COUNT && (manager->getGroups() >> (group - 1)) & 1);
+        if (!member || payload[1] == CMD_GROUP) return;
         
-        udp.beginPacket(broadcast, UDP_PORT);
-        udp.write(packet, 13 + packet[12]);
-        udp.endPacket();
+        handleCommand(payload[1], payload.data + 2, payload.len - 2);
+    }
+    
+    void onGroups(CommandView payload) {
+        if (payload.len >= 4) manager->applyGroups(payload.u32(0));
         
-        DEBUG_PRINTF("[CONNECTED] ♥ Heartbeat | Battery: %d%% | Heap: %d | RSSI: %d\n", 
-                    packet[2], heap, WiFi.RSSI());
+        uint32_t mask = manager->getGroups();
+        uint8_t reply[5] = {STATUS_GROUPS, static_cast<uint8_t>(mask), static_cast<uint8_t>(mask >> 8),
+                            static_cast<uint8_t>(mask >> 16), static_cast<uint8_t>(mask >> 24)};
+        manager->sendUDPTo(udp.remoteIP(), udp.remotePort(), reply, sizeof(reply));
     }
     
-    void checkConnection() {
-        if (millis() - connectionCheckTime < 5000) return;
-        connectionCheckTime = millis();
+    // Upload, or with an empty payload ask which program is stored (by CRC),
+    // so the app only uploads when it differs
+    void onScript(CommandView payload) {
+        const ScriptProgram* script = manager->getScript();
+        ScriptAnalysis analysis = {script->isLoaded() ? Script::OK : Script::EMPTY, 0, script->getSteps()};
+        if (payload.len > 0) analysis = manager->applyScript(payload.data, payload.len);
         
-        if (WiFi.status() != WL_CONNECTED) {
-            DEBUG_PRINTLN("[CONNECTED] ✗ WiFi lost, returning to search");
-            manager->transitionTo(createSearchingState(manager));
+        uint32_t crc = script->isLoaded() ? script->getCrc() : 0;
+        uint8_t reply[10] = {STATUS_SCRIPT, analysis.result,
+                             static_cast<uint8_t>(analysis.offset), static_cast<uint8_t>(analysis.offset >> 8),
+                             static_cast<uint8_t>(analysis.steps), static_cast<uint8_t>(analysis.steps >> 8),
+                             static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8),
+                             static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 24)};
+        manager->sendUDPTo(udp.remoteIP(), udp.remotePort(), reply, sizeof(reply));
+    }
+    
+    // New strip lengths, or with an empty payload the current ones; the
+    // reply carries the lengths after clipping to LED_MAX
+    void onSetStrips(CommandView payload) {
+        if (payload.len >= 2 * LED_STRIPS) {
+            uint16_t lengths[LED_STRIPS];
+            for (uint8_t s = 0; s < LED_STRIPS; s++) lengths[s] = payload.u16(2 * s);
+            manager->applyLayout(lengths);
+        }
+        
+        FrameBuffer* frame = manager->getFrameBuffer();
+        uint8_t reply[2 + 2 * LED_STRIPS] = {STATUS_STRIPS, LED_STRIPS};
+        for (uint8_t s = 0; s < LED_STRIPS; s++) {
+            uint16_t length = frame->getStripLength(s);
+            reply[2 + 2 * s] = static_cast<uint8_t>(length);
+            reply[3 + 2 * s] = static_cast<uint8_t>(length >> 8);
         }
+        manager->sendUDPTo(udp.remoteIP(), udp.remotePort(), reply, sizeof(reply));
+    }
+    
+    void onReset(CommandView) {
+        DEBUG_PRINTLN("[CONNECTED] Reset requested");
+        manager->clearCredentials();
+        manager->reboot();
     }
+    
+    static constexpr CommandHandler<ConnectedState> COMMANDS[] = {
+        {CMD_SET_COLOR,        3, &ConnectedState::onSetColor},
+        {CMD_SET_MOOD,         4, &ConnectedState::onSetMood},
+        {CMD_SET_BRIGHTNESS,   1, &ConnectedState::onSetBrightness},
+        {CMD_BATCH,            0, &ConnectedState::onBatch},          // Validated as a whole
+        {CMD_FRAME,            0, &ConnectedState::onFrame},
+        {CMD_GET_STATUS,       0, &ConnectedState::onGetStatus},
+        {CMD_SUBSCRIBE,        0, &ConnectedState::onSubscribe},
+        {CMD_GET_PROFILE,      0, &ConnectedState::onGetProfile},
+        {CMD_SYNC_CLOCK,       4, &ConnectedState::onSyncClock},
+        {STATUS_HEARTBEAT_V2,  4, &ConnectedState::onPeerHeartbeat},
+        {CMD_GROUP,            2, &ConnectedState::onGroup},
+        {CMD_GROUPS,           0, &ConnectedState::onGroups},
+        {CMD_SCRIPT,           0, &ConnectedState::onScript},
+        {CMD_SET_STRIPS,       0, &ConnectedState::onSetStrips},
+        {CMD_SET_POWER_BUDGET, 2, &ConnectedState::onSetPowerBudget},
+        {CMD_OTA_START,        0, &ConnectedState::onOtaStart},
+        {CMD_OTA_MULTICAST,    0, &ConnectedState::onOtaMulticast},  // MulticastOffer::parse() checks it
+        {CMD_RESET,            0, &ConnectedState::onReset},
+    };
 
 public:
     explicit ConnectedState(StateManager* mgr) 
         : LuminaState(mgr),
-          currentStrategy(nullptr),
-          lastHeartbeat(0),
-          lastStrategyUpdate(0),
-          connectionCheckTime(0) {
-        // Default to calm green
-        currentStrategy = new CalmBreathingStrategy(Colors::CONNECTED);
+          heartbeatTask(Scheduler::INVALID_TASK),
+          pendingColorSet(false),
+          pendingColorFade(0),
+          pendingBrightnessSet(false),
+          pendingBrightness(BRIGHTNESS_MAX),
+          coalescedCommands(0),
+          liveStreaming(false),
+          liveFrameReceived(false),
+          liveSequence(0),
+          lastLiveFrame(0),
+          staleFrames(0),
+          intakeTask(Scheduler::INVALID_TASK),
+          lowPower(false),
+          lastCommand(0),
+          peerHeartbeats(0) {}
+    
+    void reset() override {
+        LuminaState::reset();
+        heartbeat = HeartbeatEncoder();
+        heartbeatTask = Scheduler::INVALID_TASK;
+        pendingColorSet = false;
+        pendingColor = Color();
+        pendingColorFade = 0;
+        pendingBrightnessSet = false;
+        pendingBrightness = BRIGHTNESS_MAX;
+        coalescedCommands = 0;
+        intakeTotals = IntakeStats();
+        liveStreaming = false;
+        liveFrameReceived = false;
+        liveSequence = 0;
+        lastLiveFrame = 0;
+        staleFrames = 0;
+        intakeTask = Scheduler::INVALID_TASK;
+        lowPower = false;
+        lastCommand = 0;
+        peerHeartbeats = 0;
     }
     
     ~ConnectedState() override
     {
-        if (currentStrategy) delete currentStrategy;
         udp.stop();
     }
     
@@ -191,152 +504,103 @@ public:
         DEBUG_PRINTLN("\n[CONNECTED] Entering Connected State");
         DEBUG_PRINTF("[CONNECTED] IP: %s\n", WiFi.localIP().toString().c_str());
         
-        // Start UDP listener
-        if (udp.begin(UDP_PORT)) {
-            DEBUG_PRINTF("[CONNECTED] UDP listening on port %d\n", UDP_PORT);
+        // Start UDP listener; the socket takes unicast and the group address
+        if (udp.beginMulticast(WiFi.localIP(), IPAddress(GROUP_MULTICAST_IP), UDP_PORT)) {
+            DEBUG_PRINTF("[CONNECTED] UDP listening on port %d (and group %s)\n",
+                       UDP_PORT, IPAddress(GROUP_MULTICAST_IP).toString().c_str());
+        } else if (udp.begin(UDP_PORT)) {
+            DEBUG_PRINTF("[CONNECTED] ⚠ IGMP join failed; UDP listening on port %d\n", UDP_PORT);
         }
         
-        lastHeartbeat = 0;
-        lastStrategyUpdate = millis();
-        connectionCheckTime = millis();
-        
-        // Brief green flash to indicate connection
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        for (int i = 0; i < LED_COUNT; i++) {
-            leds->setPixelColor(i, Colors::CONNECTED.to32bit());
+        // Keep showing the restored scene; only a lamp without one gets the
+        // green connection flash and then calm green (shown once the flash ends)
+        LightingEngine* lighting = manager->getLighting();
+        if (!lighting->hasScene()) {
+            manager->applyScene(Scene::of(STRATEGY_CALM, Colors::CONNECTED), 0);
+            manager->getEffects()->play(Effects::CONNECT_FLASH, this);
         }
-        leds->show();
-        delay(500);
+        lighting->setActive(true);
+        
+        Scheduler* scheduler = manager->getScheduler();
+        intakeTask = scheduler->every(UDP_POLL_INTERVAL, [](void* self) {
+            static_cast<ConnectedState*>(self)->receiveCommands();
+        }, this);
+        lastCommand = millis();
+        scheduler->every(LOW_POWER_CHECK_INTERVAL, [](void* self) {
+            static_cast<ConnectedState*>(self)->updatePowerMode();
+        }, this, LOW_POWER_CHECK_INTERVAL);
+        scheduler->every(CONNECTION_CHECK_INTERVAL, [](void* self) {
+            static_cast<ConnectedState*>(self)->checkConnection();
+        }, this, CONNECTION_CHECK_INTERVAL);
+        heartbeatTask = scheduler->every(heartbeat.getInterval(), [](void* self) {
+            static_cast<ConnectedState*>(self)->sendHeartbeat();
+        }, this);
+        scheduler->every(30000, [](void* self) {
+            static_cast<ConnectedState*>(self)->warnLowBattery();
+        }, this);
+        
+        manager->markBoot(BOOT_CONNECTED);  // Also runs the deferred start-up work
     }
     
     void onExit() override {
         DEBUG_PRINTLN("[CONNECTED] Exiting Connected State");
         udp.stop();
         
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        leds->clear();
-        leds->show();
+        // The scene keeps showing while the next state (e.g. Searching after
+        // Wi-Fi loss) decides whether to draw something else
+        manager->getLighting()->setActive(true);
     }
     
-    void update() override {
-        checkConnection();
-        sendHeartbeat();
+    /**
+     * CMD_FRAME datagrams are read straight from the socket into the frame
+     * buffer: [CMD_FRAME, seqLo, seqHi, R, G, B x pixels]. Frames at or
+     * behind the last accepted sequence number are dropped unread.
+     */
+    bool receiveDirect(WiFiUDP& source, int packetSize) override {
+        FrameBuffer* frame = manager->getFrameBuffer();
+        if (packetSize != 3 + static_cast<int>(frame->size()) || source.peek() != CMD_FRAME) return false;
         
-        // Update lighting strategy
-        if (millis() - lastStrategyUpdate >= FADE_SPEED) {
-            lastStrategyUpdate = millis();
-            if (currentStrategy) {
-                currentStrategy->apply(manager->getLEDs(), millis());
-            }
-        }
+        uint8_t header[3];
+        source.read(header, sizeof(header));
+        uint16_t sequence = header[1] | (header[2] << 8);
         
-        // Check for incoming commands
-        int packetSize = udp.parsePacket();
-        if (packetSize > 0) {
-            uint8_t buffer[256];
-            int len = udp.read(buffer, sizeof(buffer));
-            
-            if (len > 0) {
-                handleCommand(buffer[0], &buffer[1], len - 1);
-            }
+        // Wrap-safe "not newer"; the next parsePacket() discards the pixels
+        if (liveStreaming && static_cast<int16_t>(sequence - liveSequence) <= 0) {
+            staleFrames++;
+            return true;
         }
         
-        // Battery warning
-        float voltage = manager->getBatteryVoltage();
-        if (voltage < BATTERY_WARNING && voltage > BATTERY_EMPTY) {
-            static unsigned long lastWarning = 0;
-            if (millis() - lastWarning > 30000) { // Every 30s
-                lastWarning = millis();
-                DEBUG_PRINTF("[CONNECTED] ⚠ Low battery: %.2fV\n", voltage);
-            }
+        source.read(frame->data(), frame->size());
+        if (liveFrameReceived) coalescedCommands++; // Superseded before it was shown
+        
+        if (!liveStreaming) {
+            DEBUG_PRINTLN("[CONNECTED] Live stream started");
+            liveStreaming = true;
+            manager->getLighting()->setActive(false);
+            heartbeatSoon();
         }
+        liveFrameReceived = true;
+        liveSequence = sequence;
+        lastLiveFrame = millis();
+        return true;
     }
     
     void handleCommand(uint8_t cmd, uint8_t* data, size_t len) override {
         DEBUG_PRINTF("[CONNECTED] Command: 0x%02X\n", cmd);
         
-        switch (cmd) {
-            case CMD_SET_COLOR: {
-                if (len < 3) break;
-                
-                Color newColor(data[0], data[1], data[2]);
-                
-                if (currentStrategy) delete currentStrategy;
-                currentStrategy = new SolidColorStrategy(newColor);
-                
-                DEBUG_PRINTF("[CONNECTED] Set color: RGB(%d,%d,%d)\n", 
-                           data[0], data[1], data[2]);
-                break;
-            }
-            
-            case CMD_SET_MOOD: {
-                if (len < 4) break;
-                
-                uint8_t moodType = data[0];
-                Color color(data[1], data[2], data[3]);
-                
-                if (currentStrategy) delete currentStrategy;
-                
-                switch (moodType) {
-                    case 0: // Calm
-                        currentStrategy = new CalmBreathingStrategy(color);
-                        DEBUG_PRINTLN("[CONNECTED] Mood: Calm");
-                        break;
-                    case 1: // Focus
-                        currentStrategy = new FocusStrategy(color);
-                        DEBUG_PRINTLN("[CONNECTED] Mood: Focus");
-                        break;
-                    case 2: // Party
-                        if (len >= 10) {
-                            Color c2(data[4], data[5], data[6]);
-                            Color c3(data[7], data[8], data[9]);
-                            currentStrategy = new PartyStrategy(color, c2, c3);
-                        } else {
-                            currentStrategy = new PartyStrategy(color, Colors::CONNECTED, Colors::SEARCHING);
-                        }
-                        DEBUG_PRINTLN("[CONNECTED] Mood: Party");
-                        break;
-                    default:
-                        currentStrategy = new SolidColorStrategy(color);
-                        break;
-                }
-                break;
-            }
-            
-            case CMD_SET_BRIGHTNESS: {
-                if (len < 1) break;
-                
-                uint8_t brightness = data[0];
-                Adafruit_NeoPixel* leds = manager->getLEDs();
-                leds->setBrightness(brightness);
-                leds->show();
-                
-                DEBUG_PRINTF("[CONNECTED] Brightness: %d\n", brightness);
-                break;
-            }
-            
-            case CMD_GET_STATUS: {
-                sendHeartbeat(); // Send immediate status
-                break;
-            }
-            
-            case CMD_OTA_START: {
-                DEBUG_PRINTLN("[CONNECTED] OTA update requested");
-                manager->transitionTo(createUpdatingState(manager));
-                break;
-            }
-            
-            case CMD_RESET: {
-                DEBUG_PRINTLN("[CONNECTED] Reset requested");
-                manager->clearCredentials();
-                delay(500);
-                manager->reboot();
-                break;
-            }
-            
-            default:
-                DEBUG_PRINTF("[CONNECTED] Unknown command: 0x%02X\n", cmd);
-                break;
+        // Anything but a coalescable command must see earlier ones applied
+        // (peer heartbeats don't touch the scene; a group command checks
+        // what it wraps)
+        if (cmd != CMD_SET_COLOR && cmd != CMD_SET_BRIGHTNESS && cmd != CMD_BATCH &&
+            cmd != STATUS_HEARTBEAT_V2 && cmd != CMD_GROUP) {
+            applyPendingCommands();
+        }
+        
+        CommandTable::Result result = CommandTable::dispatch(this, COMMANDS, cmd, data, len);
+        if (result == CommandTable::TOO_SHORT) {
+            DEBUG_PRINTF("[CONNECTED] ✗ Command 0x%02X too short (%u bytes)\n", cmd, len);
+        } else if (result == CommandTable::UNKNOWN) {
+            DEBUG_PRINTF("[CONNECTED] Unknown command: 0x%02X\n", cmd);
         }
     }
     
@@ -344,9 +608,10 @@ public:
     [[nodiscard]] uint8_t getStateCode() const override { return STATE_CONNECTED; }
 };
 
-// Factory function
+// Factory function: one statically allocated instance, reused on every entry
 inline LuminaState* createConnectedState(StateManager* manager) {
-    return new ConnectedState(manager);
+    static ConnectedState instance(manager);
+    return &instance;
 }
 
 #endif // CONNECTED_STATE_H
@@ -0,0 +1,50 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+** ============================================================================
+** CRC32 - IEEE 802.3 checksum (same result as zlib's crc32())
+** ============================================================================
+**
+** Nibble-at-a-time with a 16-entry table: 64 bytes of flash instead of the
+** 1 KB byte-wise table, at two table lookups per input byte.
+**
+** Usage:
+**   uint32_t crc = Crc32::compute(data, len);
+**   // or incrementally:
+**   uint32_t state = Crc32::INITIAL;
+**   state = Crc32::update(state, part1, len1);
+**   state = Crc32::update(state, part2, len2);
+**   uint32_t crc = Crc32::finish(state);
+**/
+namespace Crc32 {
+
+    constexpr uint32_t INITIAL = 0xFFFFFFFF;
+
+    static constexpr uint32_t NIBBLE_TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    inline uint32_t update(uint32_t state, const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            state ^= data[i];
+            state = (state >> 4) ^ NIBBLE_TABLE[state & 0x0F];
+            state = (state >> 4) ^ NIBBLE_TABLE[state & 0x0F];
+        }
+        return state;
+    }
+
+    constexpr uint32_t finish(uint32_t state) { return ~state; }
+
+    inline uint32_t compute(const uint8_t* data, size_t len) {
+        return finish(update(INITIAL, data, len));
+    }
+}
+
+#endif // CRC32_H
@@ -0,0 +1,205 @@
+#ifndef EFFECT_SEQUENCE_H
+#define EFFECT_SEQUENCE_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "FrameBuffer.h"
+#include "Scheduler.h"
+
+/**
+** ============================================================================
+** EFFECT SEQUENCE - Non-blocking keyframe animations
+** ============================================================================
+**
+** Flashes, sweeps and error blinks used to be for-loops around delay(),
+** which stalled Wi-Fi and command intake for up to a few seconds. An effect
+** is a table of keyframes instead; each keyframe is drawn by a one-shot
+** scheduler task that arms the next one, so the loop keeps running between
+** them.
+**
+** While an effect plays it owns the frame buffer: the manager pauses the
+** lighting engine, and states stop their own animation tasks first (or,
+** for the boot rainbow, skip their frames until isPlaying() is false).
+**
+** Usage:
+**   manager->getEffects()->play(Effects::ERROR_FLASH, this, [](void* self) {
+**       static_cast<MyState*>(self)->afterError();
+**   });
+**
+** The callback runs once the last keyframe has been held. It is dropped if
+** the owner leaves its state first (see LuminaStateManager::transitionTo).
+**/
+#define EFFECT_FILL        0         // Fill the ring with the color, then hold
+#define EFFECT_SWEEP       1         // Light one more pixel per hold, once per pixel
+#define EFFECT_RAINBOW     2         // Rainbow along the strips, turned a little per hold
+#define RAINBOW_STEPS      17        // Holds per EFFECT_RAINBOW keyframe
+#define RAINBOW_TURN       15        // Hue advance per hold (of 256)
+
+struct Keyframe {
+    uint8_t op;                           // EFFECT_*
+    const Color* color;
+    uint16_t holdMs;
+};
+
+struct Effect {
+    const Keyframe* frames;
+    uint8_t count;
+    uint8_t repeats;                      // Times the whole table is played
+};
+
+namespace Effects {
+    static constexpr Keyframe CONNECT_FLASH_FRAMES[] = {
+        {EFFECT_FILL, &Colors::CONNECTED, 500},
+    };
+
+    static constexpr Keyframe SUCCESS_FLASH_FRAMES[] = {
+        {EFFECT_FILL, &Colors::CONNECTED, 2000},
+    };
+
+    static constexpr Keyframe SUCCESS_SWEEP_FRAMES[] = {
+        {EFFECT_SWEEP, &Colors::CONNECTED, 50},
+    };
+
+    static constexpr Keyframe ERROR_FLASH_FRAMES[] = {
+        {EFFECT_FILL, &Colors::ERROR_COLOR, 200},
+        {EFFECT_FILL, &Colors::OFF, 200},
+    };
+
+    static constexpr Keyframe ERROR_PAUSE_FRAMES[] = {
+        {EFFECT_FILL, &Colors::OFF, 1000},
+    };
+
+    static constexpr Keyframe BOOT_RAINBOW_FRAMES[] = {
+        {EFFECT_RAINBOW, nullptr, 20},
+        {EFFECT_FILL, &Colors::OFF, 0},
+    };
+
+    static constexpr Effect CONNECT_FLASH = {CONNECT_FLASH_FRAMES, 1, 1};
+    static constexpr Effect SUCCESS_FLASH = {SUCCESS_FLASH_FRAMES, 1, 1};
+    static constexpr Effect SUCCESS_SWEEP = {SUCCESS_SWEEP_FRAMES, 1, 1};
+    static constexpr Effect ERROR_FLASH = {ERROR_FLASH_FRAMES, 2, 3};
+    static constexpr Effect ERROR_PAUSE = {ERROR_PAUSE_FRAMES, 1, 1};
+    static constexpr Effect BOOT_RAINBOW = {BOOT_RAINBOW_FRAMES, 2, 1};
+}
+
+class EffectSequence {
+private:
+    Scheduler* scheduler;
+    FrameBuffer* frame;
+
+    Effect effect;
+    uint8_t index;                        // Next keyframe
+    uint16_t pixel;                       // Progress through an EFFECT_SWEEP or EFFECT_RAINBOW
+    uint8_t repeatsLeft;
+    void* owner;
+    TaskCallback onDone;
+    Scheduler::TaskId stepTask;
+
+    // Red -> green -> blue -> red around 256 hues
+    static Color wheel(uint8_t hue) {
+        if (hue < 85) return Color(255 - hue * 3, hue * 3, 0);
+        if (hue < 170) {
+            hue -= 85;
+            return Color(0, 255 - hue * 3, hue * 3);
+        }
+        hue -= 170;
+        return Color(hue * 3, 0, 255 - hue * 3);
+    }
+
+    static void stepThunk(void* self) {
+        static_cast<EffectSequence*>(self)->step();
+    }
+
+    void step() {
+        stepTask = Scheduler::INVALID_TASK;
+
+        if (index >= effect.count) {
+            if (--repeatsLeft == 0) {
+                finish();
+                return;
+            }
+            index = 0;
+        }
+
+        const Keyframe& key = effect.frames[index];
+        switch (key.op) {
+            case EFFECT_SWEEP:
+                frame->setPixel(pixel, *key.color);
+                if (++pixel >= frame->length()) {
+                    pixel = 0;
+                    index++;
+                }
+                break;
+            case EFFECT_RAINBOW:
+                for (uint16_t i = 0; i < frame->length(); i++) {
+                    frame->setPixel(i, wheel(static_cast<uint8_t>(frame->pixelPhase(i) + pixel * RAINBOW_TURN)));
+                }
+                if (++pixel >= RAINBOW_STEPS) {
+                    pixel = 0;
+                    index++;
+                }
+                break;
+            default:
+                frame->fill(*key.color);
+                index++;
+                break;
+        }
+        frame->show();
+
+        stepTask = scheduler->after(key.holdMs, stepThunk, this);
+    }
+
+    void finish() {
+        TaskCallback callback = onDone;
+        void* context = owner;
+        stop();
+
+        // Last: the callback may start another effect or change state
+        if (callback) callback(context);
+    }
+
+public:
+    EffectSequence(Scheduler* sched, FrameBuffer* target)
+        : scheduler(sched),
+          frame(target),
+          effect{nullptr, 0, 0},
+          index(0),
+          pixel(0),
+          repeatsLeft(0),
+          owner(nullptr),
+          onDone(nullptr),
+          stepTask(Scheduler::INVALID_TASK) {}
+
+    // Start an effect now, replacing any effect that is still playing
+    void play(const Effect& next, void* context, TaskCallback done = nullptr) {
+        stop();
+        if (next.count == 0 || next.repeats == 0) return;
+
+        effect = next;
+        index = 0;
+        pixel = 0;
+        repeatsLeft = next.repeats;
+        owner = context;
+        onDone = done;
+        step();
+    }
+
+    // Abandon the current effect without running its callback
+    void stop() {
+        if (stepTask != Scheduler::INVALID_TASK) {
+            scheduler->cancel(stepTask);
+            stepTask = Scheduler::INVALID_TASK;
+        }
+        effect.count = 0;
+        owner = nullptr;
+        onDone = nullptr;
+    }
+
+    void stopFor(const void* context) {
+        if (isPlaying() && owner == context) stop();
+    }
+
+    [[nodiscard]] bool isPlaying() const { return effect.count > 0; }
+};
+
+#endif // EFFECT_SEQUENCE_H
@@ -0,0 +1,279 @@
+#ifndef FIRMWARE_DOWNLOAD_H
+#define FIRMWARE_DOWNLOAD_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266HTTPClient.h>
+#include <Updater.h>
+#include <WiFiClientSecure.h>
+#include <bearssl/bearssl_hash.h>
+#include "Config.h"
+
+/**
+ * What to fetch: CMD_OTA_START payload [sha256 x32][url...]
+ */
+struct OtaRequest {
+    uint8_t sha256[32];                   // Expected digest of the whole image
+    char url[OTA_URL_MAX + 1];            // http:// or https://, NUL-terminated
+
+    // Returns false if the payload is too short or the URL too long
+    bool parse(const uint8_t* data, size_t len) {
+        if (len <= sizeof(sha256) || len - sizeof(sha256) > OTA_URL_MAX) return false;
+
+        memcpy(sha256, data, sizeof(sha256));
+        size_t urlLen = len - sizeof(sha256);
+        memcpy(url, data + sizeof(sha256), urlLen);
+        url[urlLen] = '\0';
+        return strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0;
+    }
+};
+
+/**
+** ============================================================================
+** FIRMWARE DOWNLOAD - Pull an image over HTTP(S) straight into flash
+** ============================================================================
+**
+** The image is streamed into the update partition OTA_CHUNK_SIZE bytes per
+** poll(), so the loop keeps running between chunks. Every chunk goes through
+** SHA-256 as it arrives; nothing is read back from flash afterwards.
+**
+** The final chunk is held until the digest matches. Only then is it written
+** and the update committed, so a wrong or tampered image never becomes
+** bootable. If the firmware is built with signed updates, Updater checks the
+** signature as well at commit time.
+**
+** A dropped connection does not start over. The Updater and the hash stay
+** open, and the next attempt asks for the rest with "Range: bytes=<n>-". A
+** server that ignores the range (200 instead of 206) restarts the download
+** from byte 0.
+**
+** TLS is used for transport only (setInsecure()): the digest in the request
+** authenticates the image, so trust the sender of CMD_OTA_START.
+**/
+class FirmwareDownload {
+public:
+    enum Status : uint8_t {
+        IDLE,
+        RUNNING,                          // Streaming, or waiting to retry
+        COMPLETE,                         // Verified and committed; reboot to run it
+        FAILED
+    };
+
+private:
+    OtaRequest request;
+    Status status;
+    const char* error;
+
+    HTTPClient http;
+    WiFiClient plainClient;
+    BearSSL::WiFiClientSecure secureClient;
+    WiFiClient* stream;                   // Body of the current response, or nullptr
+
+    br_sha256_context hash;
+    uint32_t imageSize;                   // 0 until the first response
+    uint32_t received;                    // Bytes hashed and handed to Updater
+    uint8_t attempts;                     // Failed connections since the last data
+    unsigned long nextAttempt;
+    unsigned long lastData;
+
+    uint8_t chunk[OTA_CHUNK_SIZE];
+
+    bool isSecure() const { return strncmp(request.url, "https://", 8) == 0; }
+
+    void fail(const char* reason) {
+        DEBUG_PRINTF("[DOWNLOAD] ✗ %s\n", reason);
+        disconnect();
+        if (imageSize > 0) Update.end(); // Short of imageSize: discarded, not committed
+        error = reason;
+        status = FAILED;
+    }
+
+    void disconnect() {
+        if (stream) http.end();
+        stream = nullptr;
+    }
+
+    // Drop the connection and try again later from the current offset
+    void retryLater() {
+        disconnect();
+        if (++attempts > OTA_MAX_RETRIES) {
+            fail("Too many retries");
+            return;
+        }
+        nextAttempt = millis() + OTA_RETRY_DELAY;
+        DEBUG_PRINTF("[DOWNLOAD] Retry %d/%d from byte %u in %d ms\n",
+                   attempts, OTA_MAX_RETRIES, received, OTA_RETRY_DELAY);
+    }
+
+    void restart() {
+        if (imageSize > 0) Update.end();
+        imageSize = 0;
+        received = 0;
+        br_sha256_init(&hash);
+    }
+
+    void connect() {
+        WiFiClient* client = &plainClient;
+        if (isSecure()) {
+            secureClient.setInsecure();
+            secureClient.setBufferSizes(OTA_TLS_RX_BUFFER, 512);
+            client = &secureClient;
+        }
+
+        http.setTimeout(OTA_HTTP_TIMEOUT);
+        http.setReuse(false);
+        if (!http.begin(*client, request.url)) {
+            fail("Bad URL");
+            return;
+        }
+
+        char range[32];
+        if (received > 0) {
+            snprintf(range, sizeof(range), "bytes=%u-", received);
+            http.addHeader("Range", range);
+        }
+
+        int code = http.GET();                  // Blocks until the headers are in
+        if (received > 0 && code == HTTP_CODE_OK) {
+            DEBUG_PRINTLN("[DOWNLOAD] Server ignored the range, starting over");
+            restart();
+        } else if (code != HTTP_CODE_OK && code != HTTP_CODE_PARTIAL_CONTENT) {
+            DEBUG_PRINTF("[DOWNLOAD] ✗ HTTP %d\n", code);
+            http.end();
+            retryLater();
+            return;
+        }
+
+        int remaining = http.getSize();
+        if (remaining <= 0) {
+            http.end();
+            fail("No Content-Length");
+            return;
+        }
+
+        if (imageSize == 0) {
+            imageSize = static_cast<uint32_t>(remaining);
+            if (!Update.begin(imageSize, U_FLASH)) {
+                imageSize = 0;
+                http.end();
+                fail("Image does not fit the update partition");
+                return;
+            }
+            DEBUG_PRINTF("[DOWNLOAD] Image is %u bytes\n", imageSize);
+        } else if (received + static_cast<uint32_t>(remaining) != imageSize) {
+            http.end();
+            fail("Image changed on the server");
+            return;
+        }
+
+        stream = http.getStreamPtr();
+        lastData = millis();
+    }
+
+    // Write one chunk; the one that completes the image is verified first
+    bool consume(size_t len) {
+        br_sha256_update(&hash, chunk, len);
+
+        if (received + len == imageSize) {
+            uint8_t digest[32];
+            br_sha256_out(&hash, digest);
+            if (memcmp(digest, request.sha256, sizeof(digest)) != 0) {
+                fail("SHA-256 mismatch");
+                return false;
+            }
+        }
+
+        if (Update.write(chunk, len) != len) {
+            fail("Flash write failed");
+            return false;
+        }
+        received += len;
+        attempts = 0;
+        lastData = millis();
+
+        if (received == imageSize) {
+            disconnect();
+            if (!Update.end()) {
+                imageSize = 0;              // end() already discarded the update
+                fail("Commit failed");
+                return false;
+            }
+            DEBUG_PRINTLN("[DOWNLOAD] ✓ Image verified and committed");
+            status = COMPLETE;
+        }
+        return true;
+    }
+
+public:
+    FirmwareDownload()
+        : request{},
+          status(IDLE),
+          error(nullptr),
+          stream(nullptr),
+          hash{},
+          imageSize(0),
+          received(0),
+          attempts(0),
+          nextAttempt(0),
+          lastData(0) {}
+
+    void begin(const OtaRequest& next) {
+        cancel();
+        request = next;
+        br_sha256_init(&hash);
+        imageSize = 0;
+        received = 0;
+        attempts = 0;
+        nextAttempt = millis();
+        error = nullptr;
+        status = RUNNING;
+        DEBUG_PRINTF("[DOWNLOAD] Fetching %s\n", request.url);
+    }
+
+    // Abandon a running download; a partly written image is discarded
+    void cancel() {
+        if (status != RUNNING) return;
+        disconnect();
+        if (imageSize > 0) Update.end();
+        status = IDLE;
+    }
+
+    /**
+     * Do a slice of work: connect or reconnect when due, then move at most
+     * one chunk from the socket to flash. Call it every OTA_POLL_INTERVAL.
+     */
+    Status poll() {
+        if (status != RUNNING) return status;
+
+        if (!stream) {
+            if (WiFi.status() != WL_CONNECTED) return status; // Wait for the link
+            if (static_cast<long>(millis() - nextAttempt) < 0) return status;
+            connect();
+            return status;
+        }
+
+        size_t available = stream->available();
+        if (available == 0) {
+            if (!stream->connected() || millis() - lastData > OTA_STALL_TIMEOUT) {
+                DEBUG_PRINTF("[DOWNLOAD] Connection lost at byte %u\n", received);
+                retryLater();
+            }
+            return status;
+        }
+
+        size_t want = min(available, min(sizeof(chunk), static_cast<size_t>(imageSize - received)));
+        size_t len = stream->readBytes(chunk, want);
+        if (len > 0) consume(len);
+        return status;
+    }
+
+    [[nodiscard]] Status getStatus() const { return status; }
+    [[nodiscard]] const char* getError() const { return error; }
+    [[nodiscard]] uint32_t getReceived() const { return received; }
+
+    [[nodiscard]] uint8_t getPercent() const {
+        return imageSize > 0 ? static_cast<uint8_t>((static_cast<uint64_t>(received) * 100) / imageSize) : 0;
+    }
+};
+
+#endif // FIRMWARE_DOWNLOAD_H
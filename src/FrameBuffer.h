@@ -0,0 +1,232 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include "Config.h"
+#include "LedOutput.h"
+#include "PowerGovernor.h"
+#include "Profiler.h"
+#include "Waveform.h"
+
+/**
+** ============================================================================
+** FRAME BUFFER - Dirty-frame detection in front of the LED strips
+** ============================================================================
+**
+** Strategies and states compose frames here instead of writing to the strip
+** directly. show() compares the composed frame (pixels + brightness) against
+** the last frame actually sent and only pushes it when something changed.
+**
+** Bit-banging keeps interrupts disabled for ~30 us per LED, so every
+** skipped push is time handed back to the Wi-Fi stack.
+**
+** show() is also where the power governor sits: a frame that would draw more
+** than the current limit is pushed at a lower brightness (PowerGovernor.h).
+**
+** The frame covers up to LED_STRIPS strips laid end to end: pixel 0 is the
+** first pixel of strip 0, strip 1 starts right after strip 0's last. The
+** lengths are set at runtime (setLayout(), stored in the settings), up to
+** LED_MAX pixels in total. Strategies size themselves with length().
+**
+** An output that transmits in the background (UartOutput) keeps its own
+** copy of the frame, so the next one is composed here while it goes out.
+** If an output is still busy when show() is called the push is deferred
+** to the next call. Strips go out in order, so the blocking strip 0 is done
+** before strip 1 starts: a bit-banged transfer would stall the interrupt
+** that feeds the UART.
+**/
+class FrameBuffer {
+public:
+    static constexpr size_t CAPACITY = LED_MAX * 3;   // Bytes for the longest layout
+
+private:
+    LedOutput* outputs[LED_STRIPS];
+    uint16_t lengths[LED_STRIPS];
+    uint16_t pixelCount;                  // Sum of lengths
+    Profiler* profiler;
+    uint8_t pixels[CAPACITY];             // Frame being composed (RGB order)
+    uint8_t sent[CAPACITY];               // Last frame pushed to the strips
+    uint8_t phases[LED_MAX];              // Pixel i's position around the frame, 0..255
+    uint8_t brightness;                   // Requested
+    uint8_t sentBrightness;               // Pushed, after the current limit
+    uint16_t currentLimit;                // LED budget (mA), 0 = unlimited
+    bool sentValid;                       // False until the first push
+    uint16_t loadMilliamps;               // Estimated draw of the frame on the strips
+    uint32_t shownFrames;
+    uint32_t skippedFrames;
+    uint32_t deferredFrames;              // An output was still sending
+
+    void updatePhases() {
+        for (uint16_t i = 0; i < pixelCount; i++) {
+            phases[i] = static_cast<uint8_t>(static_cast<uint32_t>(i) * 256 / pixelCount);
+        }
+    }
+
+public:
+    // Strip 0 is `first`, LED_COUNT long; attach() adds the others
+    FrameBuffer(LedOutput* first, Profiler* timings)
+        : outputs{first},
+          lengths{LED_COUNT},
+          pixelCount(LED_COUNT),
+          profiler(timings),
+          pixels{},
+          sent{},
+          phases{},
+          brightness(BRIGHTNESS_MAX),
+          sentBrightness(BRIGHTNESS_MAX),
+          currentLimit(0),
+          sentValid(false),
+          loadMilliamps(PowerGovernor::idleMilliamps(LED_COUNT)),
+          shownFrames(0),
+          skippedFrames(0),
+          deferredFrames(0) {
+        updatePhases();
+    }
+
+    void attach(uint8_t strip, LedOutput* output) {
+        if (strip < LED_STRIPS) outputs[strip] = output;
+    }
+
+    // Start the outputs; call once, before the first show()
+    void begin() {
+        for (uint8_t s = 0; s < LED_STRIPS; s++) {
+            if (outputs[s] && lengths[s] > 0) outputs[s]->begin(lengths[s]);
+        }
+    }
+
+    /**
+     * New strip lengths (clipped so the total fits LED_MAX). A strip
+     * without an output counts as 0. Takes effect on the next show().
+     */
+    void setLayout(const uint16_t (&stripLengths)[LED_STRIPS]) {
+        uint16_t total = 0;
+        for (uint8_t s = 0; s < LED_STRIPS; s++) {
+            uint16_t length = outputs[s] ? min(stripLengths[s], static_cast<uint16_t>(LED_MAX - total)) : 0;
+            if (outputs[s] && (length > 0 || lengths[s] > 0)) outputs[s]->begin(length);
+            lengths[s] = length;
+            total += length;
+        }
+
+        pixelCount = total;
+        memset(pixels + total * 3, 0, CAPACITY - total * 3);
+        updatePhases();
+        sentValid = false;
+    }
+
+    [[nodiscard]] uint16_t getStripLength(uint8_t strip) const { return strip < LED_STRIPS ? lengths[strip] : 0; }
+
+    // ========================================================================
+    // FRAME COMPOSITION
+    // ========================================================================
+    void setPixel(uint16_t index, uint8_t r, uint8_t g, uint8_t b) {
+        if (index >= pixelCount) return;
+        uint8_t* p = &pixels[index * 3];
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+    }
+
+    void setPixel(uint16_t index, const Color& color) {
+        setPixel(index, color.r, color.g, color.b);
+    }
+
+    // Packed 0x00RRGGBB, as returned by Adafruit_NeoPixel::ColorHSV()
+    void setPixel(uint16_t index, uint32_t packed) {
+        setPixel(index, static_cast<uint8_t>(packed >> 16),
+                 static_cast<uint8_t>(packed >> 8),
+                 static_cast<uint8_t>(packed));
+    }
+
+    void fill(const Color& color) {
+        for (uint16_t i = 0; i < pixelCount; i++) {
+            setPixel(i, color);
+        }
+    }
+
+    void clear() {
+        memset(pixels, 0, sizeof(pixels));
+    }
+
+    // Raw RGB bytes (size() of them), e.g. to receive a streamed frame in place
+    [[nodiscard]] uint8_t* data() { return pixels; }
+    [[nodiscard]] size_t size() const { return pixelCount * 3; }
+    [[nodiscard]] uint16_t length() const { return pixelCount; }
+
+    // Pixel i's position along the frame as a palette index (Palette.h)
+    [[nodiscard]] uint8_t pixelPhase(uint16_t index) const { return phases[index]; }
+
+    // Crossfade: blend the composed frame with an earlier one (`from`, in
+    // data() layout); amount 0 shows `from`, LEVEL_FULL the composed frame
+    void blendFrom(const uint8_t* from, Waveform::Level amount) {
+        for (size_t i = 0; i < size(); i++) {
+            pixels[i] = Waveform::lerp8(from[i], pixels[i], amount);
+        }
+    }
+
+    [[nodiscard]] Color getPixel(uint16_t index) const {
+        if (index >= pixelCount) return Colors::OFF;
+        const uint8_t* p = &pixels[index * 3];
+        return Color(p[0], p[1], p[2]);
+    }
+
+    void setBrightness(uint8_t value) { brightness = value; }
+    [[nodiscard]] uint8_t getBrightness() const { return brightness; }
+
+    void setCurrentLimit(uint16_t milliamps) { currentLimit = milliamps; }
+    [[nodiscard]] uint16_t getCurrentLimit() const { return currentLimit; }
+
+    // ========================================================================
+    // OUTPUT
+    // ========================================================================
+
+    /**
+     * Push the composed frame to the strips if it differs from the last one
+     * sent. Returns true if the strips were actually updated.
+     */
+    bool show() {
+        PROFILE_SCOPE(profiler, PROFILE_SHOW);
+
+        size_t bytes = size();
+        uint32_t channelSum = 0;
+        for (size_t i = 0; i < bytes; i++) channelSum += pixels[i];
+        uint8_t level = PowerGovernor::limitBrightness(channelSum, brightness, currentLimit, pixelCount);
+
+        if (sentValid && level == sentBrightness &&
+            memcmp(pixels, sent, bytes) == 0) {
+            skippedFrames++;
+            return false;
+        }
+
+        for (LedOutput* output : outputs) {
+            if (output && output->isBusy()) {
+                deferredFrames++;
+                return false;
+            }
+        }
+
+        const uint8_t* slice = pixels;
+        for (uint8_t s = 0; s < LED_STRIPS; s++) {
+            if (lengths[s] > 0) outputs[s]->send(slice, level);
+            slice += lengths[s] * 3;
+        }
+        loadMilliamps = PowerGovernor::estimateMilliamps(channelSum, level, pixelCount);
+
+        memcpy(sent, pixels, bytes);
+        sentBrightness = level;
+        sentValid = true;
+        shownFrames++;
+        return true;
+    }
+
+    // Force the next show() to push, e.g. after writing to the strip directly
+    void invalidate() { sentValid = false; }
+
+    // LED current of what the strip is showing, from the last push
+    [[nodiscard]] uint16_t getLoadMilliamps() const { return loadMilliamps; }
+    [[nodiscard]] uint8_t getShownBrightness() const { return sentBrightness; }
+
+    [[nodiscard]] uint32_t getShownFrames() const { return shownFrames; }
+    [[nodiscard]] uint32_t getSkippedFrames() const { return skippedFrames; }
+    [[nodiscard]] uint32_t getDeferredFrames() const { return deferredFrames; }
+};
+
+#endif // FRAME_BUFFER_H
@@ -0,0 +1,204 @@
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** HEARTBEAT V2 - Compact, delta-encoded status with an adaptive rate
+** ============================================================================
+**
+** Packet layout (little-endian):
+**   [0]    STATUS_HEARTBEAT_V2
+**   [1]    HEARTBEAT_VERSION
+**   [2-3]  Sequence number (uint16, wraps)
+**   [4]    Field mask: which fields follow; HB_FLAG_FULL marks a snapshot
+**   [5..]  Present fields, in bit order:
+**            HB_FIELD_STATE       1 byte  state code
+**            HB_FIELD_BATTERY     3 bytes percent, millivolts (uint16)
+**            HB_FIELD_RSSI        1 byte  RSSI + 128
+**            HB_FIELD_STRATEGY    1 byte  STRATEGY_* id
+**            HB_FIELD_BRIGHTNESS  1 byte  0-255
+**            HB_FIELD_HEAP        4 bytes free heap (uint32, snapshots only)
+**            HB_FIELD_CLOCK       8 bytes network time (ms), clock rank (uint32
+**                                         each; every packet, see NetworkClock.h)
+**
+** A delta only carries the fields that changed since the last packet, plus
+** the clock; a mask with only the clock is a 13-byte liveness beat. A full snapshot goes out at least
+** every HEARTBEAT_FULL_INTERVAL and whenever one is requested. A gap in the
+** sequence number tells the receiver to wait for (or ask for) a snapshot.
+**
+** The interval drops to HEARTBEAT_INTERVAL_MIN whenever something changes,
+** then doubles on every quiet beat up to HEARTBEAT_INTERVAL_MAX.
+**/
+#define HB_FIELD_STATE       0x01
+#define HB_FIELD_BATTERY     0x02
+#define HB_FIELD_RSSI        0x04
+#define HB_FIELD_STRATEGY    0x08
+#define HB_FIELD_BRIGHTNESS  0x10
+#define HB_FIELD_HEAP        0x20
+#define HB_FIELD_CLOCK       0x40
+#define HB_FLAG_FULL         0x80
+
+#define HB_FIELDS_ALL        0x3F    // Status fields; the clock goes in every packet
+#define HB_MAX_PACKET_SIZE   25      // Header + every field
+#define HB_LIVENESS_SIZE     13      // Header + clock
+
+struct HeartbeatSnapshot {
+    uint8_t state;
+    uint8_t batteryPercent;
+    uint16_t batteryMillivolts;
+    int8_t rssi;
+    uint8_t strategyId;
+    uint8_t brightness;
+    uint32_t freeHeap;
+    uint32_t clockTime;                   // Network time when sent
+    uint32_t clockRank;
+};
+
+class HeartbeatEncoder {
+private:
+    HeartbeatSnapshot lastSent;
+    uint16_t sequence;
+    bool hasSent;
+    unsigned long lastFullTime;
+    unsigned long interval;
+
+    static void writeU16(uint8_t* out, uint16_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    static void writeU32(uint8_t* out, uint32_t value) {
+        writeU16(out, static_cast<uint16_t>(value));
+        writeU16(out + 2, static_cast<uint16_t>(value >> 16));
+    }
+
+    static uint32_t readU32(const uint8_t* in) {
+        return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+    }
+
+public:
+    HeartbeatEncoder()
+        : lastSent{},
+          sequence(0),
+          hasSent(false),
+          lastFullTime(0),
+          interval(HEARTBEAT_INTERVAL_MIN) {}
+
+    // Fields that differ enough from the last packet to be worth sending
+    [[nodiscard]] uint8_t changedFields(const HeartbeatSnapshot& now) const {
+        if (!hasSent) return HB_FIELDS_ALL;
+
+        uint8_t mask = 0;
+        if (now.state != lastSent.state) mask |= HB_FIELD_STATE;
+        if (now.batteryPercent != lastSent.batteryPercent) mask |= HB_FIELD_BATTERY;
+        if (abs(now.rssi - lastSent.rssi) >= HEARTBEAT_RSSI_HYSTERESIS) mask |= HB_FIELD_RSSI;
+        if (now.strategyId != lastSent.strategyId) mask |= HB_FIELD_STRATEGY;
+        if (now.brightness != lastSent.brightness) mask |= HB_FIELD_BRIGHTNESS;
+        return mask;
+    }
+
+    [[nodiscard]] bool fullSnapshotDue(unsigned long now) const {
+        return !hasSent || now - lastFullTime >= HEARTBEAT_FULL_INTERVAL;
+    }
+
+    /**
+     * Encode the next heartbeat into `out` (HB_MAX_PACKET_SIZE bytes) and
+     * advance the adaptive interval. Returns the packet length.
+     */
+    size_t encode(const HeartbeatSnapshot& snapshot, bool forceFull, unsigned long now, uint8_t* out) {
+        uint8_t changed = changedFields(snapshot);
+        bool full = forceFull || fullSnapshotDue(now);
+        uint8_t fields = (full ? HB_FIELDS_ALL : changed) | HB_FIELD_CLOCK;
+
+        out[0] = STATUS_HEARTBEAT_V2;
+        out[1] = HEARTBEAT_VERSION;
+        writeU16(&out[2], sequence++);
+        out[4] = fields | (full ? HB_FLAG_FULL : 0);
+
+        size_t len = 5;
+        if (fields & HB_FIELD_STATE) {
+            out[len++] = snapshot.state;
+        }
+        if (fields & HB_FIELD_BATTERY) {
+            out[len++] = snapshot.batteryPercent;
+            writeU16(&out[len], snapshot.batteryMillivolts);
+            len += 2;
+        }
+        if (fields & HB_FIELD_RSSI) {
+            out[len++] = static_cast<uint8_t>(snapshot.rssi + 128);
+        }
+        if (fields & HB_FIELD_STRATEGY) {
+            out[len++] = snapshot.strategyId;
+        }
+        if (fields & HB_FIELD_BRIGHTNESS) {
+            out[len++] = snapshot.brightness;
+        }
+        if (fields & HB_FIELD_HEAP) {
+            writeU32(&out[len], snapshot.freeHeap);
+            len += 4;
+        }
+        if (fields & HB_FIELD_CLOCK) {
+            writeU32(&out[len], snapshot.clockTime);
+            writeU32(&out[len + 4], snapshot.clockRank);
+            len += 8;
+        }
+
+        // Back off while quiet, tighten up right after a change
+        if (changed != 0) {
+            interval = HEARTBEAT_INTERVAL_MIN;
+        } else if (interval < HEARTBEAT_INTERVAL_MAX) {
+            interval = min(interval * 2, static_cast<unsigned long>(HEARTBEAT_INTERVAL_MAX));
+        }
+
+        lastSent = snapshot;
+        hasSent = true;
+        if (full) lastFullTime = now;
+        return len;
+    }
+
+    /**
+     * Clock-only liveness beat for the other lamps, numbered `seq` like the
+     * status packet it goes out with. Leaves the delta state and the interval
+     * alone. Returns the packet length (HB_LIVENESS_SIZE).
+     */
+    static size_t encodeLiveness(const HeartbeatSnapshot& snapshot, uint16_t seq, uint8_t* out) {
+        out[0] = STATUS_HEARTBEAT_V2;
+        out[1] = HEARTBEAT_VERSION;
+        writeU16(&out[2], seq);
+        out[4] = HB_FIELD_CLOCK;
+        writeU32(&out[5], snapshot.clockTime);
+        writeU32(&out[9], snapshot.clockRank);
+        return HB_LIVENESS_SIZE;
+    }
+
+    /**
+     * Clock field of another lamp's heartbeat. `body` is the packet after
+     * its STATUS_HEARTBEAT_V2 byte, as handleCommand() receives it.
+     */
+    static bool readClock(const uint8_t* body, size_t len, uint32_t& time, uint32_t& rank) {
+        if (len < 4 || body[0] != HEARTBEAT_VERSION || !(body[3] & HB_FIELD_CLOCK)) return false;
+
+        // Skip the fields before the clock; they are in bit order
+        static constexpr uint8_t FIELD_SIZES[] = {1, 3, 1, 1, 1, 4};
+        size_t offset = 4;
+        for (uint8_t bit = 0; bit < sizeof(FIELD_SIZES); bit++) {
+            if (body[3] & (1 << bit)) offset += FIELD_SIZES[bit];
+        }
+        if (len < offset + 8) return false;
+
+        time = readU32(&body[offset]);
+        rank = readU32(&body[offset + 4]);
+        return true;
+    }
+
+    // Something changed outside the heartbeat's view; beat again soon
+    void noteChange() { interval = HEARTBEAT_INTERVAL_MIN; }
+
+    [[nodiscard]] unsigned long getInterval() const { return interval; }
+    [[nodiscard]] uint16_t getSequence() const { return sequence; }
+};
+
+#endif // HEARTBEAT_H
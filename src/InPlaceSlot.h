@@ -0,0 +1,113 @@
+#ifndef IN_PLACE_SLOT_H
+#define IN_PLACE_SLOT_H
+
+#include <new>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+** ============================================================================
+** IN-PLACE SLOT - Fixed storage for one of a closed set of types
+** ============================================================================
+**
+** A variant-like holder for polymorphic objects: storage is sized and aligned
+** for the largest of Types, and objects are constructed in it with placement
+** new. Swapping the held object never touches the heap, so frequent swaps
+** cannot fragment it.
+**
+** The slot remembers which of Types it holds, which lets callers update an
+** existing object in place (as<T>()) instead of rebuilding it. This works
+** without RTTI, which the ESP8266 toolchain disables.
+**
+** Usage:
+**   InPlaceSlot<Base, A, B> slot;
+**   slot.emplace<A>(args...);
+**   if (A* a = slot.as<A>()) a->tweak();
+**   slot->virtualMethod();
+**/
+namespace InPlaceDetail {
+    template <typename... Ts>
+    struct MaxSize;
+
+    template <typename T>
+    struct MaxSize<T> {
+        static constexpr size_t value = sizeof(T);
+    };
+
+    template <typename T, typename... Ts>
+    struct MaxSize<T, Ts...> {
+        static constexpr size_t value =
+            sizeof(T) > MaxSize<Ts...>::value ? sizeof(T) : MaxSize<Ts...>::value;
+    };
+
+    // Position of T in Ts (1-based); 0 = not found
+    template <typename T, typename... Ts>
+    struct IndexOf;
+
+    template <typename T>
+    struct IndexOf<T> {
+        static constexpr uint8_t value = 0;
+    };
+
+    template <typename T, typename... Ts>
+    struct IndexOf<T, T, Ts...> {
+        static constexpr uint8_t value = 1;
+    };
+
+    template <typename T, typename U, typename... Ts>
+    struct IndexOf<T, U, Ts...> {
+        static constexpr uint8_t next = IndexOf<T, Ts...>::value;
+        static constexpr uint8_t value = next == 0 ? 0 : next + 1;
+    };
+}
+
+template <typename Base, typename... Types>
+class InPlaceSlot {
+private:
+    alignas(Types...) unsigned char storage[InPlaceDetail::MaxSize<Types...>::value];
+    Base* object;
+    uint8_t held;                         // IndexOf<T, Types...> of the held object
+
+public:
+    static constexpr size_t CAPACITY = InPlaceDetail::MaxSize<Types...>::value;
+
+    InPlaceSlot() : object(nullptr), held(0) {}
+    ~InPlaceSlot() { reset(); }
+
+    InPlaceSlot(const InPlaceSlot&) = delete;
+    InPlaceSlot& operator=(const InPlaceSlot&) = delete;
+
+    // Destroy the held object (if any) and construct a T in its place
+    template <typename T, typename... Args>
+    T* emplace(Args&&... args) {
+        static_assert(InPlaceDetail::IndexOf<T, Types...>::value != 0,
+                      "Type is not one of the slot's declared types");
+        reset();
+        T* created = new (storage) T(std::forward<Args>(args)...);
+        object = created;
+        held = InPlaceDetail::IndexOf<T, Types...>::value;
+        return created;
+    }
+
+    void reset() {
+        if (object) {
+            object->~Base();
+            object = nullptr;
+            held = 0;
+        }
+    }
+
+    // The held object as a T, or nullptr if the slot holds something else
+    template <typename T>
+    [[nodiscard]] T* as() const {
+        if (held != InPlaceDetail::IndexOf<T, Types...>::value || held == 0) return nullptr;
+        return static_cast<T*>(object);
+    }
+
+    [[nodiscard]] Base* get() const { return object; }
+    Base* operator->() const { return object; }
+    explicit operator bool() const { return object != nullptr; }
+};
+
+#endif // IN_PLACE_SLOT_H
@@ -0,0 +1,166 @@
+#ifndef LED_OUTPUT_H
+#define LED_OUTPUT_H
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <esp8266_peri.h>
+#include <ets_sys.h>
+#include "Config.h"
+#include "Waveform.h"
+
+/**
+** ============================================================================
+** LED OUTPUT - Drivers that move a frame onto one WS2812B strip
+** ============================================================================
+**
+** FrameBuffer::show() hands each strip its slice of the frame: RGB bytes,
+** plus the brightness to push them at. Two drivers exist:
+**
+**   - NeoPixelOutput bit-bangs through Adafruit_NeoPixel on any pin. It
+**     keeps interrupts off for the whole transfer, ~30 us per LED, which
+**     is fine for the 16-LED ring and ruinous for Wi-Fi at 144.
+**   - UartOutput drives UART1 TX (GPIO2 / D4) from its TX FIFO interrupt.
+**     send() copies the slice, scaled and in GRB order, into the driver's
+**     own buffer and returns at once; the interrupt feeds the FIFO while
+**     the loop computes the next frame into the frame buffer.
+**
+** A strip with length 0 is not driven.
+**/
+class LedOutput {
+protected:
+    uint16_t length;
+    uint32_t frames;
+
+public:
+    LedOutput() : length(0), frames(0) {}
+    virtual ~LedOutput() = default;
+
+    virtual void begin(uint16_t pixels) = 0;                        // Also to change the length
+    virtual void send(const uint8_t* rgb, uint8_t brightness) = 0;  // `length` pixels
+    [[nodiscard]] virtual bool isBusy() const { return false; }     // The last frame is still going out
+
+    [[nodiscard]] uint16_t getLength() const { return length; }
+    [[nodiscard]] uint32_t getFrames() const { return frames; }
+};
+
+class NeoPixelOutput : public LedOutput {
+private:
+    Adafruit_NeoPixel strip;
+
+public:
+    explicit NeoPixelOutput(int16_t pin) : strip(0, pin, NEO_GRB + NEO_KHZ800) {}
+
+    void begin(uint16_t pixels) override {
+        length = pixels;
+        strip.updateLength(pixels);
+        strip.begin();
+    }
+
+    void send(const uint8_t* rgb, uint8_t brightness) override {
+        // Adafruit_NeoPixel scales pixels by brightness as they are set, so
+        // every pixel is rewritten after a brightness change
+        strip.setBrightness(brightness);
+        for (uint16_t i = 0; i < length; i++) {
+            const uint8_t* p = &rgb[i * 3];
+            strip.setPixelColor(i, p[0], p[1], p[2]);
+        }
+        strip.show();
+        frames++;
+    }
+};
+
+/**
+ * WS2812B over UART1 at 3.2 Mbaud, 6N1, TX inverted: every UART frame is
+ * start + 6 data + stop = 8 bits of 312.5 ns, and encodes two LED bits as
+ * 1.25 us each (the NeoPixelBus technique). One LED byte is four UART
+ * bytes, 10 us on the wire.
+ *
+ * The UART interrupt is shared with UART0. Attaching ours replaces the
+ * core's handler, which only serves Serial RX; this firmware never reads
+ * Serial. Debug output on Serial TX is unaffected.
+ */
+class UartOutput : public LedOutput {
+private:
+    static constexpr uint8_t UART = 1;
+    static constexpr uint32_t BAUD = 3200000;
+    static constexpr uint8_t FIFO_SIZE = 128;
+    static constexpr uint8_t FIFO_REFILL = 80;            // Interrupt below this many queued bytes
+    static constexpr uint32_t LATCH_US = 300;             // Low time that ends a frame (WS2812B rev. 5)
+    static constexpr uint32_t US_PER_PIXEL = 30;          // 3 bytes x 4 UART bytes x 2.5 us
+
+    // Two LED bits (MSB first) as the 6 data bits of one inverted UART frame
+    static constexpr uint8_t ENCODING[4] = {0b110111, 0b000111, 0b110100, 0b000100};
+
+    static UartOutput* active;            // The one instance the interrupt serves
+
+    uint8_t grb[LED_MAX * 3];             // Frame going out, scaled
+    const uint8_t* volatile cursor;
+    const uint8_t* end;
+    unsigned long sentAt;                 // micros() when the frame started
+    uint32_t frameUs;                     // Wire time + latch of one frame
+
+    void IRAM_ATTR fill() {
+        while (cursor < end) {
+            if (((USS(UART) >> USTXC) & 0xFF) > FIFO_SIZE - 4) return; // Full; wait for the next interrupt
+            uint8_t value = *cursor++;
+            USF(UART) = ENCODING[(value >> 6) & 3];
+            USF(UART) = ENCODING[(value >> 4) & 3];
+            USF(UART) = ENCODING[(value >> 2) & 3];
+            USF(UART) = ENCODING[value & 3];
+        }
+        USIE(UART) &= ~(1 << UIFE);      // Queued to the end; stop asking
+    }
+
+    static void IRAM_ATTR onInterrupt(void*) {
+        if ((USIS(UART) & (1 << UIFE)) && active) active->fill();
+        USIC(UART) = 0xFFFF;
+        USIC(0) = 0xFFFF;                 // Nobody else handles UART0 now
+    }
+
+public:
+    UartOutput() : grb{}, cursor(nullptr), end(nullptr), sentAt(0), frameUs(0) {}
+
+    void begin(uint16_t pixels) override {
+        length = min(pixels, static_cast<uint16_t>(LED_MAX));
+        frameUs = length * US_PER_PIXEL + LATCH_US;
+        if (length == 0 || active == this) return;   // Not wired, or already running
+
+        Serial1.begin(BAUD, SERIAL_6N1, SERIAL_TX_ONLY);
+        USC0(UART) |= (1 << UCTXI);      // Idle low; start bit high
+        USC1(UART) = FIFO_REFILL << UCFET;
+
+        ETS_UART_INTR_DISABLE();
+        active = this;
+        ETS_UART_INTR_ATTACH(onInterrupt, nullptr);
+        USIE(0) = 0;                      // Serial RX interrupts: not used
+        USIC(UART) = 0xFFFF;
+        USIE(UART) = 0;
+        ETS_UART_INTR_ENABLE();
+    }
+
+    void send(const uint8_t* rgb, uint8_t brightness) override {
+        Waveform::Level level = Waveform::fromByte(brightness);
+        for (uint16_t i = 0; i < length; i++) {
+            const uint8_t* p = &rgb[i * 3];
+            uint8_t* out = &grb[i * 3];
+            out[0] = Waveform::scale8(p[1], level);
+            out[1] = Waveform::scale8(p[0], level);
+            out[2] = Waveform::scale8(p[2], level);
+        }
+
+        cursor = grb;
+        end = grb + length * 3;
+        sentAt = micros();
+        USIE(UART) |= (1 << UIFE);       // The FIFO is empty: fires at once
+        frames++;
+    }
+
+    // Until the last byte has left the wire and the latch time has passed
+    [[nodiscard]] bool isBusy() const override {
+        return cursor < end || (frames > 0 && micros() - sentAt < frameUs);
+    }
+};
+
+inline UartOutput* UartOutput::active = nullptr;
+
+#endif // LED_OUTPUT_H
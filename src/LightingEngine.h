@@ -0,0 +1,301 @@
+#ifndef LIGHTING_ENGINE_H
+#define LIGHTING_ENGINE_H
+
+#include <Arduino.h>
+#include "AnimationScript.h"
+#include "Config.h"
+#include "FrameBuffer.h"
+#include "InPlaceSlot.h"
+#include "Palette.h"
+#include "Scene.h"
+#include "Waveform.h"
+
+/**
+ * Lighting Strategies (Strategy Pattern)
+ * Strategies only compose frames; the engine's owner pushes them to the strip.
+ */
+class LightingStrategy {
+public:
+    virtual ~LightingStrategy() = default;
+    virtual void apply(FrameBuffer* frame, unsigned long time) = 0;
+    virtual void configure(const Scene& scene) = 0;          // Take new parameters in place
+    [[nodiscard]] virtual const char* getName() const = 0;
+    [[nodiscard]] virtual uint8_t getId() const = 0;         // STRATEGY_* code
+    [[nodiscard]] virtual bool isStatic() const { return false; } // Output only changes in configure()
+};
+
+class SolidColorStrategy : public LightingStrategy {
+private:
+    Color color;
+
+public:
+    explicit SolidColorStrategy(const Scene& scene) : color(scene.color(0)) {}
+
+    void configure(const Scene& scene) override { color = scene.color(0); }
+
+    void apply(FrameBuffer* frame, unsigned long) override {
+        frame->fill(color);
+    }
+
+    [[nodiscard]] const char* getName() const override { return "Solid"; }
+    [[nodiscard]] uint8_t getId() const override { return STRATEGY_SOLID; }
+    [[nodiscard]] bool isStatic() const override { return true; }
+};
+
+class CalmBreathingStrategy : public LightingStrategy {
+private:
+    Color baseColor;
+
+public:
+    explicit CalmBreathingStrategy(const Scene& scene) : baseColor(scene.color(0)) {}
+
+    void configure(const Scene& scene) override { baseColor = scene.color(0); }
+
+    void apply(FrameBuffer* frame, unsigned long time) override {
+        // Slow sine wave breathing (4-second cycle), gamma-corrected so the
+        // fade looks even to the eye
+        uint8_t wave = Waveform::gamma8(Waveform::sine8(Waveform::phase<4000>(time)));
+        Color c = Waveform::scale(baseColor, Waveform::fromByte(wave));
+
+        frame->fill(c);
+    }
+
+    [[nodiscard]] const char* getName() const override { return "Calm"; }
+    [[nodiscard]] uint8_t getId() const override { return STRATEGY_CALM; }
+};
+
+class FocusStrategy : public LightingStrategy {
+private:
+    static constexpr Waveform::Level LEVEL_MIN = 179; // 0.7 in 8.8 fixed point
+
+    Color color;
+
+public:
+    explicit FocusStrategy(const Scene& scene) : color(scene.color(0)) {}
+
+    void configure(const Scene& scene) override { color = scene.color(0); }
+
+    void apply(FrameBuffer* frame, unsigned long time) override {
+        // Steady light with subtle pulsing (slower than calm)
+        uint8_t wave = Waveform::sine8(Waveform::phase<8000>(time));
+        Color c = Waveform::scale(color, Waveform::range(wave, LEVEL_MIN, Waveform::LEVEL_FULL)); // 0.7 to 1.0
+
+        frame->fill(c);
+    }
+
+    [[nodiscard]] const char* getName() const override { return "Focus"; }
+    [[nodiscard]] uint8_t getId() const override { return STRATEGY_FOCUS; }
+};
+
+class PartyStrategy : public LightingStrategy {
+private:
+    Palette palette;                      // The three colors as equal bands
+
+public:
+    explicit PartyStrategy(const Scene& scene) { configure(scene); }
+
+    void configure(const Scene& scene) override {
+        Color colors[3] = {scene.color(0), scene.color(1), scene.color(2)};
+        palette.bands(colors, 3);
+    }
+
+    void apply(FrameBuffer* frame, unsigned long time) override {
+        // Rotating segments, one pixel every 50 ms
+        uint16_t pixels = frame->length();
+        if (pixels == 0) return;
+        palette.draw(frame, frame->pixelPhase(static_cast<uint16_t>((time / 50) % pixels)));
+    }
+
+    [[nodiscard]] const char* getName() const override { return "Party"; }
+    [[nodiscard]] uint8_t getId() const override { return STRATEGY_PARTY; }
+};
+
+class GradientStrategy : public LightingStrategy {
+private:
+    Palette palette;
+
+public:
+    explicit GradientStrategy(const Scene& scene) { configure(scene); }
+
+    void configure(const Scene& scene) override {
+        Color colors[3] = {scene.color(0), scene.color(1), scene.color(2)};
+        palette.gradient(colors, 3);
+    }
+
+    void apply(FrameBuffer* frame, unsigned long time) override {
+        // The blend drifts once around the ring per GRADIENT_PERIOD
+        palette.draw(frame, static_cast<uint8_t>(Waveform::phase<GRADIENT_PERIOD>(time) >> 8));
+    }
+
+    [[nodiscard]] const char* getName() const override { return "Gradient"; }
+    [[nodiscard]] uint8_t getId() const override { return STRATEGY_GRADIENT; }
+};
+
+// Plays the uploaded program (AnimationScript.h) with the scene's colors
+class ScriptStrategy : public LightingStrategy {
+private:
+    const ScriptProgram* program;
+    Scene scene;
+
+public:
+    ScriptStrategy(const Scene& next, const ScriptProgram* script) : program(script), scene(next) {}
+
+    void configure(const Scene& next) override { scene = next; }
+
+    void apply(FrameBuffer* frame, unsigned long time) override {
+        program->run(frame, time, scene);
+    }
+
+    [[nodiscard]] const char* getName() const override { return "Script"; }
+    [[nodiscard]] uint8_t getId() const override { return STRATEGY_SCRIPT; }
+};
+
+/**
+ * Storage for one strategy. Sized for the largest strategy so that switching
+ * strategies never allocates; add new strategies to this list.
+ */
+typedef InPlaceSlot<LightingStrategy,
+                    SolidColorStrategy,
+                    CalmBreathingStrategy,
+                    FocusStrategy,
+                    PartyStrategy,
+                    GradientStrategy,
+                    ScriptStrategy> StrategySlot;
+
+/**
+** ============================================================================
+** LIGHTING ENGINE - The active scene, its strategy and transitions
+** ============================================================================
+**
+** Owned by the state manager rather than a state, so the scene outlives
+** state transitions: the scene restored from flash is showing before Wi-Fi
+** even starts, and it keeps showing while the lamp reconnects.
+**
+** States that draw their own animation (provisioning, OTA) or stream frames
+** pause the engine with setActive(false).
+**/
+class LightingEngine {
+private:
+    // Two slots so the outgoing strategy keeps animating while a transition
+    // fades it into the incoming one; activeSlot holds the incoming/current
+    StrategySlot strategies[2];
+    uint8_t activeSlot;
+    unsigned long fadeStart;
+    uint16_t fadeDuration;                // 0 = no transition running
+    uint8_t fadeFrom[FrameBuffer::CAPACITY];
+
+    Scene scene;
+    bool sceneSet;
+    bool active;
+    const ScriptProgram* script;          // Program behind STRATEGY_SCRIPT
+
+    StrategySlot& current() { return strategies[activeSlot]; }
+    StrategySlot& outgoing() { return strategies[activeSlot ^ 1]; }
+
+    /**
+     * Keep the current strategy running as the outgoing one and return the
+     * slot to build the incoming strategy in. A transition that is already
+     * running is cut short: its incoming strategy becomes the new outgoing.
+     */
+    StrategySlot& beginTransition(uint16_t duration) {
+        activeSlot ^= 1;
+        fadeStart = millis();
+        fadeDuration = duration;
+        return current();                  // emplace() discards the older outgoing
+    }
+
+    void finishTransition() {
+        if (fadeDuration == 0) return;
+        outgoing().reset();
+        fadeDuration = 0;
+    }
+
+    // Fade to a new T over fadeMs; without a fade, reconfigure the current
+    // strategy if it is already a T, otherwise swap in a new T. Extra
+    // constructor arguments follow the scene
+    template <typename T, typename... Args>
+    void select(const Scene& next, uint16_t fadeMs, Args... args) {
+        if (fadeMs > 0 && current()) {
+            beginTransition(fadeMs).emplace<T>(next, args...);
+            return;
+        }
+
+        finishTransition();
+        if (T* existing = current().as<T>()) {
+            existing->configure(next);
+        } else {
+            current().emplace<T>(next, args...);
+        }
+    }
+
+public:
+    LightingEngine()
+        : activeSlot(0),
+          fadeStart(0),
+          fadeDuration(0),
+          fadeFrom{},
+          scene{},
+          sceneSet(false),
+          active(false),
+          script(nullptr) {}
+
+    // Set once by the owner; the program may be replaced in place later
+    void setScript(const ScriptProgram* program) { script = program; }
+
+    void setScene(const Scene& next, uint16_t fadeMs = 0) {
+        switch (next.strategyId) {
+            case STRATEGY_CALM:  select<CalmBreathingStrategy>(next, fadeMs); break;
+            case STRATEGY_FOCUS: select<FocusStrategy>(next, fadeMs); break;
+            case STRATEGY_PARTY: select<PartyStrategy>(next, fadeMs); break;
+            case STRATEGY_GRADIENT: select<GradientStrategy>(next, fadeMs); break;
+            case STRATEGY_SCRIPT:
+                if (script && script->isLoaded()) select<ScriptStrategy>(next, fadeMs, script);
+                else select<SolidColorStrategy>(next, fadeMs);  // Nothing uploaded
+                break;
+            default:             select<SolidColorStrategy>(next, fadeMs); break;
+        }
+
+        scene = next;
+        scene.strategyId = current()->getId();
+        sceneSet = true;
+    }
+
+    [[nodiscard]] const Scene& getScene() const { return scene; }
+    [[nodiscard]] bool hasScene() const { return sceneSet; }
+
+    void setActive(bool value) { active = value; }
+    [[nodiscard]] bool isActive() const { return active && sceneSet; }
+
+    // True while frames cannot change until the next setScene(): the
+    // strategy is static and no transition is running
+    [[nodiscard]] bool isStatic() {
+        return isActive() && fadeDuration == 0 && current() && current()->isStatic();
+    }
+
+    // Compose the next frame (does not push it to the strip)
+    void render(FrameBuffer* frame, unsigned long now) { render(frame, now, now); }
+
+    // Transitions run on local time (`now`); strategies animate against
+    // `sceneTime`, the shared network time, so grouped lamps stay in phase
+    void render(FrameBuffer* frame, unsigned long now, unsigned long sceneTime) {
+        if (!isActive()) return;
+
+        if (fadeDuration > 0) {
+            unsigned long elapsed = now - fadeStart;
+            if (elapsed >= fadeDuration || !outgoing()) {
+                finishTransition();
+            } else {
+                // Both strategies keep animating; lerp from outgoing to incoming
+                outgoing()->apply(frame, sceneTime);
+                memcpy(fadeFrom, frame->data(), frame->size());
+                current()->apply(frame, sceneTime);
+                frame->blendFrom(fadeFrom, static_cast<Waveform::Level>((elapsed << 8) / fadeDuration));
+                return;
+            }
+        }
+
+        current()->apply(frame, sceneTime);
+    }
+};
+
+#endif // LIGHTING_ENGINE_H
@@ -0,0 +1,78 @@
+#ifndef LINK_CACHE_H
+#define LINK_CACHE_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** LINK CACHE - Details of the last successful Wi-Fi connection
+** ============================================================================
+**
+** A plain WiFi.begin(ssid, password) scans every channel before it can
+** associate. With the access point's BSSID and channel remembered, a reboot
+** goes straight to association and skips the scan.
+**
+** With FAST_RECONNECT_STATIC_IP the last DHCP lease is also reused as a
+** static configuration, which skips the DHCP exchange too. The lease time is
+** not tracked, so this is only safe when the router reserves the address for
+** the lamp; otherwise the address may be handed to another client after the
+** lease runs out.
+**
+** The cache is persisted with the credentials (see SettingsStore.h). It is
+** only a hint: if the fast path fails, SearchingState falls back to a full
+** scan and the cache is rewritten from the connection that succeeds.
+**/
+struct LinkCache {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t checksum;
+    uint32_t ip;                          // 0 = no lease cached, use DHCP
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+
+    // Snapshot of the connection that is currently up
+    static LinkCache capture() {
+        LinkCache cache{};
+        memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+        cache.channel = static_cast<uint8_t>(WiFi.channel());
+#if FAST_RECONNECT_STATIC_IP
+        cache.ip = static_cast<uint32_t>(WiFi.localIP());
+        cache.gateway = static_cast<uint32_t>(WiFi.gatewayIP());
+        cache.subnet = static_cast<uint32_t>(WiFi.subnetMask());
+        cache.dns = static_cast<uint32_t>(WiFi.dnsIP());
+#endif
+        cache.checksum = cache.computeChecksum();
+        return cache;
+    }
+
+    // Rotating XOR over every byte except the checksum itself
+    [[nodiscard]] uint8_t computeChecksum() const {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(this);
+        uint8_t sum = 0x5A;
+        for (size_t i = 0; i < sizeof(LinkCache); i++) {
+            if (i == offsetof(LinkCache, checksum)) continue;
+            sum = static_cast<uint8_t>((sum << 1) | (sum >> 7)) ^ bytes[i];
+        }
+        return sum;
+    }
+
+    [[nodiscard]] bool isValid() const {
+        return channel >= 1 && channel <= 14 && checksum == computeChecksum();
+    }
+
+    // A lease cached before FAST_RECONNECT_STATIC_IP was turned off is ignored
+    [[nodiscard]] bool hasLease() const {
+        return FAST_RECONNECT_STATIC_IP && ip != 0 && gateway != 0 && subnet != 0;
+    }
+
+    [[nodiscard]] bool operator==(const LinkCache& other) const {
+        return memcmp(this, &other, sizeof(LinkCache)) == 0;
+    }
+};
+
+static_assert(sizeof(LinkCache) == 24, "LinkCache must not contain padding");
+
+#endif // LINK_CACHE_H
@@ -2,9 +2,22 @@
 #define LUMINA_STATE_MANAGER_H
 
 #include "States.h"
+#include "AnimationScript.h"
+#include "BatteryMonitor.h"
+#include "EffectSequence.h"
+#include "FrameBuffer.h"
+#include "LightingEngine.h"
+#include "LedOutput.h"
+#include "LinkCache.h"
+#include "NetworkClock.h"
+#include "PacketIntake.h"
+#include "PowerGovernor.h"
+#include "Profiler.h"
+#include "Scheduler.h"
+#include "SubscriberTable.h"
 #include "SearchingState.h"
-#include <Adafruit_NeoPixel.h>
 #include <WiFiUdp.h>
+#include "SettingsStore.h"
 #include <EEPROM.h>
 
 /**
@@ -15,115 +28,328 @@
 class LuminaStateManager : public StateManager {
 private:
     LuminaState* currentState;
-    Adafruit_NeoPixel leds;
+    Scheduler scheduler;
+    Profiler profiler;
+    NetworkClock clock;                   // Animation time base shared with other lamps
+    NeoPixelOutput ring;                  // Strip 0
+    UartOutput uart;                      // Strip 1
+    FrameBuffer frame;
+    EffectSequence effects;
+    LightingEngine lighting;
+    ScriptProgram script;                 // Uploaded animation (CMD_SCRIPT)
+    Scheduler::TaskId renderTask;
+    Scheduler::TaskId bootTask;           // finishBoot(), until it has run
+    unsigned long renderPeriod;
+    bool lowPower;
     WiFiUDP udp;
-    unsigned long lastBatteryRead;
-    float lastBatteryVoltage;
-    uint8_t lastBatteryPercent;
+    uint8_t packetBuffer[PacketIntake::BUFFER_SIZE]; // Shared by every state's intake
+    SubscriberTable subscribers;
+    SettingsStore settings;
+    Scheduler::TaskId settingsTask;       // Pending debounced write
+    unsigned long settingsDirtySince;
+    BatteryMonitor battery;
+    uint32_t lastHeap;
+    uint32_t minFreeBlock;                // Low-water mark of the largest free block
+    bool rebootPending;
     
-    // Voltage divider calculation (adjust R1/R2 for your circuit)
-    // ESP8266 ADC: 0-1V = 0-1023
-    // 18650: 3.0-4.2V needs voltage divider
-    // Example: R1=330k, R2=100k -> 4.2V becomes 0.977V
-    static float readBatteryVoltage() {
-        constexpr float R1 = 330000.0; // Resistor to battery (ohms)
-        constexpr float R2 = 100000.0; // Resistor to ground (ohms)
-        constexpr float ADC_REF = 1.0; // ESP8266 ADC reference voltage
+    static constexpr const char* BOOT_MARK_NAMES[BOOT_MARKS] = {
+        "start", "settings", "first frame", "wifi", "associated", "connected", "deferred",
+    };
+    
+    // Battery voltage divider: see BATTERY_DIVIDER_R1/R2 in Config.h
+    // ESP8266 ADC: 0-1V = 0-1023; R1=330k, R2=100k -> 4.2V becomes 0.977V
+    // Readings are taken in idle(); this only starts the next burst
+    void sampleBattery() {
+        updatePowerBudget();              // From the last burst's state of charge
+        battery.startBurst();
+    }
+    
+    void updatePowerBudget() {
+        uint16_t budget = PowerGovernor::budgetFor(settings.data().powerBudget, battery.getPercent());
+        if (budget == frame.getCurrentLimit()) return;
+        
+        frame.setCurrentLimit(budget);
+        DEBUG_PRINTF("[POWER] LED budget %d mA (battery %d%%)\n", budget, battery.getPercent());
+    }
+    
+    // Memory leak detection
+    void checkHeap() {
+        uint32_t currentHeap = EspClass::getFreeHeap();
+        
+        if (lastHeap > currentHeap && lastHeap - currentHeap > 1024) { // Lost more than 1KB
+            DEBUG_PRINTF("⚠ Memory leak detected! Lost %d bytes\n", 
+                       lastHeap - currentHeap);
+        }
+        
+        lastHeap = currentHeap;
+        trackFreeBlock();
+    }
+    
+    /**
+     * Free heap alone hides fragmentation: plenty can be free while the
+     * largest block is too small for OTA or a TCP buffer.
+     */
+    uint32_t trackFreeBlock() {
+        uint32_t block = EspClass::getMaxFreeBlockSize();
+        if (block < minFreeBlock) {
+            minFreeBlock = block;
+            if (block < MIN_FREE_BLOCK) {
+                DEBUG_PRINTF("⚠ Heap fragmented: largest free block %d bytes (%d%%)\n",
+                           block, EspClass::getHeapFragmentation());
+            }
+        }
+        return block;
+    }
+    
+    // ========================================================================
+    // SETTINGS
+    // ========================================================================
+    
+    // First boot after an update from the EEPROM layout: carry the credentials over
+    void importLegacySettings() {
+        EEPROM.begin(EEPROM_SIZE);
+        
+        uint8_t ssidLen = EEPROM.read(ADDR_SSID_LEN);
+        uint8_t passLen = EEPROM.read(ADDR_PASS_LEN);
+        if (EEPROM.read(ADDR_MAGIC) == EEPROM_MAGIC && ssidLen <= 32 && passLen <= 64) {
+            Settings& data = settings.data();
+            for (uint8_t i = 0; i < ssidLen; i++) data.network.ssid[i] = static_cast<char>(EEPROM.read(ADDR_SSID + i));
+            for (uint8_t i = 0; i < passLen; i++) data.network.password[i] = static_cast<char>(EEPROM.read(ADDR_PASS + i));
+            data.hasCredentials = true;
+            
+            DEBUG_PRINTLN("[SETTINGS] Imported credentials from EEPROM");
+            commitSettings();
+        }
+        
+        EEPROM.end(); // Frees the 512-byte RAM mirror
+    }
+    
+    /**
+     * Debounce: write once changes have stopped for SETTINGS_WRITE_DELAY, but
+     * no later than SETTINGS_MAX_WRITE_DELAY after the first one
+     */
+    void settingsChanged() {
+        unsigned long now = millis();
+        
+        if (settingsTask == Scheduler::INVALID_TASK) {
+            settingsDirtySince = now;
+            settingsTask = scheduler.after(SETTINGS_WRITE_DELAY, [](void* self) {
+                static_cast<LuminaStateManager*>(self)->commitSettings();
+            }, this);
+        } else if (now - settingsDirtySince + SETTINGS_WRITE_DELAY <= SETTINGS_MAX_WRITE_DELAY) {
+            scheduler.postpone(settingsTask, SETTINGS_WRITE_DELAY);
+        }
+    }
+    
+    // Record what is showing now; written by the debounce
+    void persistScene() {
+        Settings& data = settings.data();
+        data.hasScene = lighting.hasScene();
+        data.scene = lighting.getScene();
+        data.brightness = frame.getBrightness();
+        settingsChanged();
+    }
+    
+    // Start-up work nothing waits on: runs once connected (or after
+    // BOOT_DEFER_TIMEOUT, for a lamp that never connects)
+    void finishBoot() {
+        bootTask = Scheduler::INVALID_TASK;
+        
+        lastHeap = EspClass::getFreeHeap();
+        trackFreeBlock();
+        battery.startBurst();             // First full reading, taken in idle()
+        
+        DEBUG_PRINTLN("\n========================================");
+        DEBUG_PRINTLN("       LUMINA SMART LAMP v" FIRMWARE_VERSION);
+        DEBUG_PRINTLN("========================================");
+        DEBUG_PRINTF("Chip ID: %08X\n", ESP.getChipId());
+        DEBUG_PRINTF("Flash: %d KB\n", ESP.getFlashChipSize() / 1024);
+        DEBUG_PRINTF("Free Heap: %d bytes\n", ESP.getFreeHeap());
+        DEBUG_PRINTF("Battery: %d mV (%d%%)\n", battery.getMillivolts(), battery.getPercent());
+        for (uint8_t mark = 0; mark < BOOT_DEFERRED; mark++) {
+            DEBUG_PRINTF("Boot %-11s %lu ms\n", BOOT_MARK_NAMES[mark],
+                         static_cast<unsigned long>(profiler.getBootMark(static_cast<BootMark>(mark))));
+        }
+        DEBUG_PRINTLN("========================================\n");
         
-        int rawADC = analogRead(BATTERY_PIN);
-        float adcVoltage = static_cast<float>(rawADC / 1023.0) * ADC_REF;
-        float batteryVoltage = adcVoltage * ((R1 + R2) / R2);
+        markBoot(BOOT_DEFERRED);
+        DEBUG_PRINTF("[BOOT] Deferred work done at %lu ms\n", static_cast<unsigned long>(profiler.getBootMark(BOOT_DEFERRED)));
+    }
+    
+    // Saved strip lengths, or the ring alone; also starts the outputs
+    void restoreLayout() {
+        const Settings& data = settings.data();
+        uint16_t lengths[LED_STRIPS] = {LED_COUNT};
+        if (data.hasLayout) memcpy(lengths, data.stripLengths, sizeof(lengths));
         
-        // Simple averaging to smooth readings
-        static float readings[4] = {0, 0, 0, 0};
-        static int index = 0;
-        readings[index] = batteryVoltage;
-        index = (index + 1) % 4;
+        frame.setLayout(lengths);
+        DEBUG_PRINTF("[LEDS] %u pixels (strip 0: %u)\n", frame.length(), frame.getStripLength(0));
+    }
+    
+    // Instant-on: show the saved scene before Wi-Fi is even started
+    void restoreScene() {
+        const Settings& data = settings.data();
+        if (!data.hasScene) return;
         
-        float sum = 0;
-        for (float reading : readings) sum += reading;
+        frame.setBrightness(data.brightness);
+        lighting.setScene(data.scene);
+        lighting.setActive(true);
+        renderLighting();
         
-        return static_cast<float>(sum / 4.0);
+        DEBUG_PRINTF("[SETTINGS] ✓ Restored scene (strategy %d) after %lu ms\n",
+                   data.scene.strategyId, millis());
     }
     
-    static uint8_t voltageToPercent(float voltage) {
-        // Linear approximation: 3.0V = 0%, 4.2V = 100%
-        // For more accuracy, use a lookup table with a real discharge curve
-        if (voltage >= BATTERY_FULL) return 100;
-        if (voltage <= BATTERY_EMPTY) return 0;
+    void renderLighting() {
+        if (!lighting.isActive() || effects.isPlaying()) return;
+        {
+            PROFILE_SCOPE(&profiler, PROFILE_RENDER);
+            unsigned long now = millis();
+            lighting.render(&frame, now, clock.now(now));
+        }
+        frame.show();
         
-        return static_cast<uint8_t>((voltage - BATTERY_EMPTY) / (BATTERY_FULL - BATTERY_EMPTY) * 100.0);
+        // A static scene only needs an occasional pass; applyScene() triggers
+        // an immediate render, which switches back to the fast rate
+        unsigned long period = lighting.isStatic() ? STATIC_RENDER_INTERVAL : FADE_SPEED;
+        if (period != renderPeriod) {
+            renderPeriod = period;
+            scheduler.setPeriod(renderTask, period);
+        }
+    }
+    
+    bool commitSettings() {
+        if (settingsTask != Scheduler::INVALID_TASK) {
+            scheduler.cancel(settingsTask);
+            settingsTask = Scheduler::INVALID_TASK;
+        }
+        return settings.commit();
     }
 
+    // Move network `index` to the front, shifting the ones before it down
+    void moveNetworkToFront(uint8_t index) {
+        Settings& data = settings.data();
+        WifiNetwork moved = data.networkAt(index);
+        for (uint8_t i = index; i > 0; i--) data.networkAt(i) = data.networkAt(i - 1);
+        data.network = moved;
+    }
+    
 public:
     LuminaStateManager() 
         : currentState(nullptr),
-          leds(LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800),
-          lastBatteryRead(0),
-          lastBatteryVoltage(0),
-          lastBatteryPercent(0) {}
+          clock(ESP.getChipId()),
+          ring(LED_PIN),
+          frame(&ring, &profiler),
+          effects(&scheduler, &frame),
+          renderTask(Scheduler::INVALID_TASK),
+          bootTask(Scheduler::INVALID_TASK),
+          renderPeriod(FADE_SPEED),
+          lowPower(false),
+          packetBuffer{},
+          settingsTask(Scheduler::INVALID_TASK),
+          settingsDirtySince(0),
+          lastHeap(0),
+          minFreeBlock(UINT32_MAX),
+          rebootPending(false) {
+        frame.attach(1, &uart);
+    }
     
     ~LuminaStateManager() override {
         if (currentState) {
             currentState->onExit();
-            delete currentState;
         }
     }
     
+    /**
+     * Only what the first frame and Wi-Fi need runs here: settings, the
+     * saved scene, and the first state, which starts association. The boot
+     * animation plays from the scheduler while the lamp connects, and the
+     * banner, heap baseline and first full battery burst wait for
+     * finishBoot(). Each phase is recorded with markBoot().
+     */
     void begin() {
-        // Initialize LEDs
-        leds.begin();
-        leds.setBrightness(BRIGHTNESS_MAX);
-        leds.clear();
-        leds.show();
+        markBoot(BOOT_START);
         
-        // Initialize EEPROM
-        EEPROM.begin(EEPROM_SIZE);
+        // Load settings (newest record in the flash ring)
+        if (!settings.begin()) {
+            importLegacySettings();
+        }
         
-        // Initial battery reading
-        lastBatteryVoltage = readBatteryVoltage();
-        lastBatteryPercent = voltageToPercent(lastBatteryVoltage);
-        lastBatteryRead = millis();
+        // The scene restored below may be the uploaded script
+        if (ScriptStore::load(script)) {
+            DEBUG_PRINTF("[SCRIPT] ✓ Loaded %u bytes, %u steps/frame\n", script.getLength(), script.getSteps());
+        }
+        lighting.setScript(&script);
         
-        DEBUG_PRINTLN("\n========================================");
-        DEBUG_PRINTLN("       LUMINA SMART LAMP v" FIRMWARE_VERSION);
-        DEBUG_PRINTLN("========================================");
-        DEBUG_PRINTF("Chip ID: %08X\n", ESP.getChipId());
-        DEBUG_PRINTF("Flash: %d KB\n", ESP.getFlashChipSize() / 1024);
-        DEBUG_PRINTF("Free Heap: %d bytes\n", ESP.getFreeHeap());
-        DEBUG_PRINTF("Battery: %.2fV (%d%%)\n", lastBatteryVoltage, lastBatteryPercent);
-        DEBUG_PRINTLN("========================================\n");
+        // Strip lengths come first: the idle draw below depends on them
+        restoreLayout();
+        markBoot(BOOT_SETTINGS);
+        
+        // One quick battery reading (LEDs still dark), so that the very
+        // first frame already respects the power budget
+        battery.begin(frame.getLoadMilliamps());
+        updatePowerBudget();
+        
+        // Light up straight into the saved scene if there is one
+        frame.setBrightness(BRIGHTNESS_MAX);
+        frame.clear();
+        restoreScene();
+        frame.show();
+        markBoot(BOOT_FIRST_FRAME);
         
-        // Start in SearchingState
+        // System tasks (the manager is their context, so they survive transitions)
+        renderTask = scheduler.every(FADE_SPEED, [](void* self) {
+            static_cast<LuminaStateManager*>(self)->renderLighting();
+        }, this);
+        scheduler.every(BATTERY_SAMPLE_INTERVAL, [](void* self) {
+            static_cast<LuminaStateManager*>(self)->sampleBattery();
+        }, this, BATTERY_SAMPLE_INTERVAL);
+        scheduler.every(HEAP_CHECK_INTERVAL, [](void* self) {
+            static_cast<LuminaStateManager*>(self)->checkHeap();
+        }, this, HEAP_CHECK_INTERVAL);
+        bootTask = scheduler.after(BOOT_DEFER_TIMEOUT, [](void* self) {
+            static_cast<LuminaStateManager*>(self)->finishBoot();
+        }, this);                         // Brought forward once connected
+        
+        // Start in SearchingState, which starts association
         transitionTo(createSearchingState(this));
+        
+        // Rainbow while it connects, unless the saved scene is already up
+        #if BOOT_ANIMATION
+        if (!lighting.hasScene()) effects.play(Effects::BOOT_RAINBOW, this);
+        #endif
     }
     
     void update() {
+        PROFILE_SCOPE(&profiler, PROFILE_LOOP);
+        
         if (currentState) {
+            PROFILE_SCOPE(&profiler, PROFILE_STATE_UPDATE);
             currentState->update();
         }
         
-        // Update battery reading every 10 seconds
-        if (millis() - lastBatteryRead > 10000) {
-            lastBatteryRead = millis();
-            lastBatteryVoltage = readBatteryVoltage();
-            lastBatteryPercent = voltageToPercent(lastBatteryVoltage);
-        }
+        scheduler.run(millis());
+    }
+    
+    /**
+     * Sleep until the next scheduled task is due. delay() hands the CPU to
+     * the SDK, which services Wi-Fi and can idle the core in the meantime.
+     */
+    void idle() {
+        unsigned long now = millis();
+        unsigned long wait = scheduler.timeUntilNext(now);
         
-        // Memory leak detection
-        static uint32_t lastHeap = EspClass::getFreeHeap();
-        static unsigned long lastHeapCheck = millis();
+        // Spare time: take the next battery reading of a running burst
+        if (wait > 0 && battery.wantsSample(now)) {
+            battery.sample(frame.getLoadMilliamps());
+            now = millis();
+            wait = scheduler.timeUntilNext(now);
+        }
         
-        if (millis() - lastHeapCheck > 30000) { // Check every 30s
-            uint32_t currentHeap = EspClass::getFreeHeap();
-            
-            if (lastHeap - currentHeap > 1024) { // Lost more than 1KB
-                DEBUG_PRINTF("⚠ Memory leak detected! Lost %d bytes\n", 
-                           lastHeap - currentHeap);
-            }
-            
-            lastHeap = currentHeap;
-            lastHeapCheck = millis();
+        if (wait > 0) {
+            delay(wait);
+        } else {
+            yield();
         }
     }
     
@@ -142,35 +368,67 @@ public:
                        currentState->getName(), 
                        newState->getName());
             currentState->onExit();
-            delete currentState; // Free memory!
+            scheduler.cancelAll(currentState);
+            effects.stopFor(currentState);
+            setLowPower(false);
+            // Not deleted: states are singletons, so transitions never touch the heap
         } else {
             DEBUG_PRINTF("→ Initial state: %s\n", newState->getName());
         }
         
-        // Enter a new state
+        // Enter a new state (possibly the one just left)
         currentState = newState;
+        currentState->reset();
         currentState->onEnter();
         
-        DEBUG_PRINTF("✓ Free Heap after transition: %d bytes\n", ESP.getFreeHeap());
+        [[maybe_unused]] uint32_t block = trackFreeBlock(); // Also updates minFreeBlock
+        DEBUG_PRINTF("✓ Free Heap after transition: %d bytes (largest block %d, lowest %d)\n",
+                   ESP.getFreeHeap(), block, minFreeBlock);
     }
     
     [[nodiscard]] LuminaState* getCurrentState() const override {
         return currentState;
     }
     
+    Scheduler* getScheduler() override {
+        return &scheduler;
+    }
+    
     // ========================================================================
     // HARDWARE ACCESS
     // ========================================================================
-    Adafruit_NeoPixel* getLEDs() override {
-        return &leds;
+    FrameBuffer* getFrameBuffer() override {
+        return &frame;
+    }
+    
+    LightingEngine* getLighting() override {
+        return &lighting;
+    }
+    
+    EffectSequence* getEffects() override {
+        return &effects;
+    }
+    
+    Profiler* getProfiler() override {
+        return &profiler;
+    }
+    
+    NetworkClock* getClock() override {
+        return &clock;
+    }
+    
+    // Reaching Connected also brings the deferred start-up work forward
+    void markBoot(BootMark mark) override {
+        if (!profiler.markBoot(mark, millis())) return;
+        if (mark == BOOT_CONNECTED && bootTask != Scheduler::INVALID_TASK) scheduler.trigger(bootTask);
     }
     
     float getBatteryVoltage() override {
-        return lastBatteryVoltage;
+        return battery.getVoltage();
     }
     
     uint8_t getBatteryPercent() override {
-        return lastBatteryPercent;
+        return battery.getPercent();
     }
     
     // ========================================================================
@@ -179,14 +437,38 @@ public:
     bool sendUDP(const uint8_t* data, size_t len) override {
         if (!isWiFiConnected()) return false;
         
+        // Unicast to every live subscriber
+        if (subscribers.expire(millis()) > 0) {
+            bool sent = true;
+            for (const SubscriberTable::Subscriber& entry : subscribers) {
+                if (!entry.active) continue;
+                sent &= sendUDPTo(entry.ip, entry.port, data, len);
+            }
+            return sent;
+        }
+        
+        // Nobody subscribed: broadcast so the app can discover us
         IPAddress broadcast = WiFi.localIP();
         broadcast[3] = 255;
-        
-        udp.beginPacket(broadcast, UDP_PORT);
+        return sendUDPTo(broadcast, UDP_PORT, data, len);
+    }
+    
+    bool sendUDPTo(const IPAddress& ip, uint16_t port, const uint8_t* data, size_t len) override {
+        udp.beginPacket(ip, port);
         udp.write(data, len);
         return udp.endPacket() == 1;
     }
     
+    // The current state's socket, read into the one packet buffer; handlers
+    // get views into it, valid until they return
+    IntakeStats receiveCommands(WiFiUDP& source) override {
+        return PacketIntake::drain(source, this, currentState, packetBuffer);
+    }
+    
+    SubscriberTable* getSubscribers() override {
+        return &subscribers;
+    }
+    
     bool isWiFiConnected() override {
         return WiFi.status() == WL_CONNECTED;
     }
@@ -196,102 +478,206 @@ public:
     }
     
     // ========================================================================
-    // CREDENTIAL MANAGEMENT (EEPROM)
+    // SCENE
     // ========================================================================
-    bool saveCredentials(const String& ssid, const String& password) override {
-        DEBUG_PRINTLN("[EEPROM] Saving credentials...");
-        
-        if (ssid.length() > 32 || password.length() > 64) {
-            DEBUG_PRINTLN("[EEPROM] ✗ Credentials too long");
-            return false;
-        }
-        
-        // Write magic byte
-        EEPROM.write(ADDR_MAGIC, EEPROM_MAGIC);
+    void applyScene(const Scene& scene, uint16_t fadeMs) override {
+        lighting.setScene(scene, fadeMs);
+        scheduler.trigger(renderTask);    // Render on the next pass, not up to a frame later
+        persistScene();
+    }
+    
+    void applyBrightness(uint8_t brightness) override {
+        frame.setBrightness(brightness);
+        frame.show();
+        persistScene();
+    }
+    
+    void applyPowerBudget(uint16_t milliamps) override {
+        settings.data().powerBudget = milliamps;
+        updatePowerBudget();
+        frame.show();
+        settingsChanged();
+    }
+    
+    void applyGroups(uint32_t mask) override {
+        if (mask == settings.data().groups) return;
         
-        // Write SSID
-        EEPROM.write(ADDR_SSID_LEN, ssid.length());
-        for (size_t i = 0; i < ssid.length(); i++) {
-            EEPROM.write(ADDR_SSID + i, ssid[i]);
+        settings.data().groups = mask;
+        settingsChanged();
+        DEBUG_PRINTF("[GROUPS] Member of 0x%08X\n", mask);
+    }
+    
+    [[nodiscard]] uint32_t getGroups() const override {
+        return settings.data().groups;
+    }
+    
+    // A scene already showing the script picks up the new program on its
+    // next frame
+    ScriptAnalysis applyScript(const uint8_t* program, size_t len) override {
+        ScriptAnalysis analysis = script.load(program, len);
+        if (analysis.result != Script::OK) {
+            DEBUG_PRINTF("[SCRIPT] ✗ Rejected (result %u at byte %u)\n", analysis.result, analysis.offset);
+            return analysis;
         }
         
-        // Write Password
-        EEPROM.write(ADDR_PASS_LEN, password.length());
-        for (size_t i = 0; i < password.length(); i++) {
-            EEPROM.write(ADDR_PASS + i, password[i]);
+        if (!ScriptStore::save(script)) {
+            DEBUG_PRINTLN("[SCRIPT] ✗ Flash write failed; playing until reboot");
+            analysis.result = Script::NOT_STORED;
         }
+        DEBUG_PRINTF("[SCRIPT] ✓ %u bytes, %u steps/frame\n", script.getLength(), analysis.steps);
+        scheduler.trigger(renderTask);
+        return analysis;
+    }
+    
+    [[nodiscard]] const ScriptProgram* getScript() const override {
+        return &script;
+    }
+    
+    void applyLayout(const uint16_t* lengths) override {
+        Settings& data = settings.data();
+        data.hasLayout = 1;
+        memcpy(data.stripLengths, lengths, sizeof(data.stripLengths));
         
-        // Commit to flash
-        if (EEPROM.commit()) {
-            DEBUG_PRINTLN("[EEPROM] ✓ Credentials saved");
-            return true;
-        } else {
-            DEBUG_PRINTLN("[EEPROM] ✗ Failed to commit");
-            return false;
-        }
+        frame.setLayout(data.stripLengths);
+        DEBUG_PRINTF("[LEDS] %u pixels\n", frame.length());
+        scheduler.trigger(renderTask);
+        settingsChanged();
     }
     
-    bool loadCredentials(String& ssid, String& password) override {
-        DEBUG_PRINTLN("[EEPROM] Loading credentials...");
+    // ========================================================================
+    // CREDENTIAL MANAGEMENT
+    // ========================================================================
+    // Adds the network, or updates its password, and makes it the first to try
+    bool saveCredentials(const char* ssid, const char* password) override {
+        DEBUG_PRINTLN("[SETTINGS] Saving credentials...");
         
-        // Check magic byte
-        if (EEPROM.read(ADDR_MAGIC) != EEPROM_MAGIC) {
-            DEBUG_PRINTLN("[EEPROM] ✗ No valid data (bad magic)");
+        Settings& data = settings.data();
+        if (strlen(ssid) == 0 || strlen(ssid) >= sizeof(data.network.ssid) ||
+            strlen(password) >= sizeof(data.network.password)) {
+            DEBUG_PRINTLN("[SETTINGS] ✗ Invalid credentials");
             return false;
         }
         
-        // Read SSID
-        uint8_t ssidLen = EEPROM.read(ADDR_SSID_LEN);
-        if (ssidLen > 32) {
-            DEBUG_PRINTLN("[EEPROM] ✗ Invalid SSID length");
-            return false;
+        // A known SSID keeps its slot; otherwise the least recently used is dropped
+        uint8_t slot = WIFI_NETWORKS - 1;
+        for (uint8_t i = 0; i < WIFI_NETWORKS; i++) {
+            if (strcmp(data.networkAt(i).ssid, ssid) == 0) {
+                slot = i;
+                break;
+            }
         }
         
-        ssid = "";
-        for (int i = 0; i < ssidLen; i++) {
-            ssid += static_cast<char>(EEPROM.read(ADDR_SSID + i));
+        WifiNetwork& network = data.networkAt(slot);
+        strlcpy(network.ssid, ssid, sizeof(network.ssid));
+        strlcpy(network.password, password, sizeof(network.password));
+        moveNetworkToFront(slot);
+        data.hasCredentials = true;
+        if (slot != 0) data.hasLink = false; // The cached link belongs to another network
+        
+        // Written straight away: a reboot usually follows
+        return commitSettings();
+    }
+    
+    bool loadCredentials(uint8_t index, char* ssid, size_t ssidSize, char* password, size_t passwordSize) override {
+        const Settings& data = settings.data();
+        if (!data.hasCredentials || index >= WIFI_NETWORKS || data.networkAt(index).ssid[0] == '\0') {
+            return false;                 // SearchingState::onEnter() logs an empty list
         }
         
-        // Read Password
-        uint8_t passLen = EEPROM.read(ADDR_PASS_LEN);
-        if (passLen > 64) {
-            DEBUG_PRINTLN("[EEPROM] ✗ Invalid password length");
-            return false;
+        strlcpy(ssid, data.networkAt(index).ssid, ssidSize);
+        if (password) strlcpy(password, data.networkAt(index).password, passwordSize);
+        return true;
+    }
+    
+    void promoteNetwork(uint8_t index) override {
+        if (index == 0 || index >= WIFI_NETWORKS) return;
+        
+        moveNetworkToFront(index);
+        settings.data().hasLink = false;  // Rewritten by the caller for the new first network
+        settingsChanged();
+        DEBUG_PRINTF("[SETTINGS] '%s' is now the first network to try\n", settings.data().network.ssid);
+    }
+    
+    void clearCredentials() override {
+        DEBUG_PRINTLN("[SETTINGS] Clearing credentials...");
+        
+        Settings& data = settings.data();
+        for (uint8_t i = 0; i < WIFI_NETWORKS; i++) {
+            memset(&data.networkAt(i), 0, sizeof(WifiNetwork));
         }
+        data.hasCredentials = false;
+        data.hasLink = false;
         
-        password = "";
-        for (int i = 0; i < passLen; i++) {
-            password += static_cast<char>(EEPROM.read(ADDR_PASS + i));
+        if (commitSettings()) {
+            DEBUG_PRINTLN("[SETTINGS] ✓ Credentials cleared");
         }
+    }
+    
+    // ========================================================================
+    // LINK CACHE
+    // ========================================================================
+    bool saveLinkCache(const LinkCache& cache) override {
+        Settings& data = settings.data();
+        if (data.hasLink && data.link == cache) return true;
+        
+        data.link = cache;
+        data.hasLink = true;
+        settingsChanged();
         
-        DEBUG_PRINTF("[EEPROM] ✓ Loaded SSID: '%s'\n", ssid.c_str());
+        DEBUG_PRINTF("[SETTINGS] Link cached (channel %d)\n", cache.channel);
         return true;
     }
     
-    void clearCredentials() override {
-        DEBUG_PRINTLN("[EEPROM] Clearing credentials...");
+    bool loadLinkCache(LinkCache& cache) override {
+        const Settings& data = settings.data();
+        if (!data.hasLink || !data.link.isValid()) return false;
         
-        // Clear magic byte
-        EEPROM.write(ADDR_MAGIC, 0x00);
-        EEPROM.commit();
+        cache = data.link;
+        return true;
+    }
+    
+    // ========================================================================
+    // RADIO POWER
+    // ========================================================================
+    void setLowPower(bool enabled) override {
+        if (enabled == lowPower) return;
+        lowPower = enabled;
         
-        DEBUG_PRINTLN("[EEPROM] ✓ Credentials cleared");
+        // Light sleep keeps the association; the radio wakes for every DTIM
+        // beacon (LOW_POWER_LISTEN_INTERVAL = 0), where the AP releases
+        // buffered packets
+        WiFi.setSleepMode(enabled ? WIFI_LIGHT_SLEEP : WIFI_MODEM_SLEEP, LOW_POWER_LISTEN_INTERVAL);
+        DEBUG_PRINTF("[POWER] %s\n", enabled ? "Low power (light sleep)" : "Awake (modem sleep)");
     }
     
     // ========================================================================
     // SYSTEM CONTROL
     // ========================================================================
     void reboot() override {
-        DEBUG_PRINTLN("\n[SYSTEM] Rebooting in 2 seconds...");
-        leds.clear();
-        leds.show();
-        delay(2000);
-        EspClass::restart();
+        if (rebootPending) return;
+        rebootPending = true;
+        
+        DEBUG_PRINTF("\n[SYSTEM] Rebooting in %d ms...\n", REBOOT_DELAY);
+        commitSettings(); // Don't lose a debounced write
+        
+        effects.stop();
+        lighting.setActive(false);
+        frame.clear();
+        frame.show();
+        
+        // The loop keeps running meanwhile, so pending replies still go out
+        scheduler.after(REBOOT_DELAY, [](void*) {
+            EspClass::restart();
+        }, this);
     }
     
     uint32_t getFreeHeap() override {
         return EspClass::getFreeHeap();
     }
+    
+    uint32_t getMaxFreeBlock() override {
+        return EspClass::getMaxFreeBlockSize();
+    }
 };
 
 #endif // LUMINA_STATE_MANAGER_H
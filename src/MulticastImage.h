@@ -0,0 +1,354 @@
+#ifndef MULTICAST_IMAGE_H
+#define MULTICAST_IMAGE_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <flash_hal.h>
+#include <eboot_command.h>
+#include <bearssl/bearssl_hash.h>
+#include "Config.h"
+
+/**
+ * A multicast rollout: CMD_OTA_MULTICAST payload
+ * [group IP x4][port u16][session u16][image size u32][sha256 x32]
+ */
+struct MulticastOffer {
+    IPAddress group;
+    uint16_t port;
+    uint16_t session;                     // Tags every packet of this rollout
+    uint32_t imageSize;
+    uint8_t sha256[32];
+
+    static constexpr size_t PAYLOAD_SIZE = 4 + 2 + 2 + 4 + 32;
+
+    bool parse(const uint8_t* data, size_t len) {
+        if (len < PAYLOAD_SIZE) return false;
+
+        group = IPAddress(data[0], data[1], data[2], data[3]);
+        port = data[4] | (data[5] << 8);
+        session = data[6] | (data[7] << 8);
+        imageSize = static_cast<uint32_t>(data[8]) | (static_cast<uint32_t>(data[9]) << 8) |
+                    (static_cast<uint32_t>(data[10]) << 16) | (static_cast<uint32_t>(data[11]) << 24);
+        memcpy(sha256, &data[12], sizeof(sha256));
+        return data[0] >= 224 && data[0] <= 239 && imageSize > 0; // Class D only
+    }
+
+    [[nodiscard]] uint16_t chunkCount() const {
+        return static_cast<uint16_t>((imageSize + OTA_MC_CHUNK_SIZE - 1) / OTA_MC_CHUNK_SIZE);
+    }
+};
+
+/**
+** ============================================================================
+** MULTICAST IMAGE - Receive one firmware image with the whole fleet
+** ============================================================================
+**
+** One sender streams numbered chunks to a multicast group, and every lamp
+** writes each chunk straight to its place in the update partition as it
+** arrives. The airtime is the same for one lamp or sixty. A bitmap tracks
+** which chunks are still missing. When the sender ends a pass, or the group
+** goes quiet, each lamp sends the sender a unicast NACK listing its gaps.
+** The sender then resends only those chunks.
+**
+** Packets (first byte is the type, then session u16; all little-endian):
+**   sender → group   OTA_MC_DATA  [index u16][payload, OTA_MC_CHUNK_SIZE or the tail]
+**   sender → group   OTA_MC_END   pass finished; lamps with gaps NACK now
+**   lamp   → sender  OTA_MC_NACK  [count][index u16 x count]
+**   lamp   → sender  OTA_MC_DONE  image complete and verified
+**
+** Chunks arrive out of order, so Updater (sequential only) is bypassed. The
+** image goes to the address Updater would use: the end of the free space
+** before the filesystem. Each sector is erased when its first chunk
+** arrives. Once every chunk is in, the image is read back through SHA-256
+** one block per poll. Only a matching image gets the eboot copy command, so
+** a bad one never boots.
+**/
+class MulticastImage {
+public:
+    enum Status : uint8_t {
+        IDLE,
+        RECEIVING,
+        VERIFYING,                        // All chunks in, hashing the flash copy
+        COMPLETE,                         // Verified and armed; reboot to run it
+        FAILED
+    };
+
+private:
+    static constexpr size_t CHUNKS_PER_SECTOR = SPI_FLASH_SEC_SIZE / OTA_MC_CHUNK_SIZE;
+    static constexpr size_t HEADER_SIZE = 5;  // type, session, index
+
+    static_assert(SPI_FLASH_SEC_SIZE % OTA_MC_CHUNK_SIZE == 0, "Chunks must not straddle sectors");
+    static_assert(OTA_MC_CHUNK_SIZE % 4 == 0, "Flash access is word-aligned");
+
+    MulticastOffer offer;
+    Status status;
+    const char* error;
+    WiFiUDP udp;
+
+    uint32_t startAddress;
+    uint16_t chunkCount;
+    uint16_t chunksReceived;
+    uint8_t have[OTA_MC_MAX_CHUNKS / 8];
+    uint8_t erased[OTA_MC_MAX_CHUNKS / CHUNKS_PER_SECTOR / 8 + 1];
+
+    IPAddress senderIP;                   // Learned from the data packets
+    uint16_t senderPort;
+    unsigned long lastChunk;
+    unsigned long nextNack;               // 0 = none scheduled
+
+    br_sha256_context hash;
+    uint32_t verifyOffset;
+
+    // Word buffer for one chunk; flash reads and writes must be 4-byte aligned
+    union ChunkBuffer {
+        uint32_t words[OTA_MC_CHUNK_SIZE / 4];
+        uint8_t bytes[OTA_MC_CHUNK_SIZE];
+    } buffer;
+
+    static bool testBit(const uint8_t* bits, size_t i) { return bits[i >> 3] & (1 << (i & 7)); }
+    static void setBit(uint8_t* bits, size_t i) { bits[i >> 3] |= (1 << (i & 7)); }
+
+    [[nodiscard]] size_t chunkLength(uint16_t index) const {
+        return index + 1 < chunkCount ? OTA_MC_CHUNK_SIZE
+                                      : offer.imageSize - static_cast<uint32_t>(index) * OTA_MC_CHUNK_SIZE;
+    }
+
+    void fail(const char* reason) {
+        DEBUG_PRINTF("[MULTICAST] ✗ %s\n", reason);
+        error = reason;
+        status = FAILED;
+        finish();
+    }
+
+    void finish() {
+        udp.stop();
+        WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+    }
+
+    void sendControl(uint8_t type, const uint16_t* indices, uint8_t count) {
+        if (!senderIP.isSet()) return;
+
+        uint8_t packet[4 + 2 * OTA_MC_NACK_MAX];
+        packet[0] = type;
+        packet[1] = static_cast<uint8_t>(offer.session);
+        packet[2] = static_cast<uint8_t>(offer.session >> 8);
+        packet[3] = count;
+        for (uint8_t i = 0; i < count; i++) {
+            packet[4 + 2 * i] = static_cast<uint8_t>(indices[i]);
+            packet[5 + 2 * i] = static_cast<uint8_t>(indices[i] >> 8);
+        }
+
+        udp.beginPacket(senderIP, senderPort);
+        udp.write(packet, 4 + 2 * count);
+        udp.endPacket();
+    }
+
+    // Ask for the first OTA_MC_NACK_MAX missing chunks
+    void sendNack() {
+        uint16_t missing[OTA_MC_NACK_MAX];
+        uint8_t count = 0;
+        for (uint16_t i = 0; i < chunkCount && count < OTA_MC_NACK_MAX; i++) {
+            if (!testBit(have, i)) missing[count++] = i;
+        }
+
+        sendControl(OTA_MC_NACK, missing, count);
+        DEBUG_PRINTF("[MULTICAST] NACK %d chunks (%u/%u received)\n",
+                   count, chunksReceived, chunkCount);
+    }
+
+    // Spread the NACKs of many lamps out instead of all answering at once
+    void scheduleNack(unsigned long now, unsigned long delayMs) {
+        nextNack = now + delayMs + random(OTA_MC_NACK_JITTER);
+        if (nextNack == 0) nextNack = 1;
+    }
+
+    void storeChunk(uint16_t index, size_t len) {
+        // Pad the tail chunk so the write stays word-aligned
+        size_t padded = (len + 3) & ~static_cast<size_t>(3);
+        memset(buffer.bytes + len, 0xFF, padded - len);
+
+        size_t sector = index / CHUNKS_PER_SECTOR;
+        if (!testBit(erased, sector)) {
+            if (!ESP.flashEraseSector(startAddress / SPI_FLASH_SEC_SIZE + sector)) {
+                fail("Flash erase failed");
+                return;
+            }
+            setBit(erased, sector);
+        }
+
+        if (!ESP.flashWrite(startAddress + static_cast<uint32_t>(index) * OTA_MC_CHUNK_SIZE,
+                            buffer.words, padded)) {
+            fail("Flash write failed");
+            return;
+        }
+        setBit(have, index);
+        chunksReceived++;
+    }
+
+    // Returns true if a chunk that was still missing was stored
+    bool receivePacket(int packetSize, unsigned long now) {
+        uint8_t header[HEADER_SIZE];
+        if (packetSize < 3 || udp.read(header, 3) != 3) return false;
+
+        uint16_t session = header[1] | (header[2] << 8);
+        if (session != offer.session) return false;
+
+        if (header[0] == OTA_MC_END) {
+            senderIP = udp.remoteIP();
+            senderPort = udp.remotePort();
+            if (chunksReceived < chunkCount) scheduleNack(now, 0);
+            return false;
+        }
+        if (header[0] != OTA_MC_DATA || packetSize < static_cast<int>(HEADER_SIZE)) return false;
+        if (udp.read(header + 3, 2) != 2) return false;
+
+        uint16_t index = header[3] | (header[4] << 8);
+        if (index >= chunkCount || testBit(have, index)) return false;
+
+        size_t len = chunkLength(index);
+        if (static_cast<size_t>(packetSize) - HEADER_SIZE != len) return false;
+        if (udp.read(buffer.bytes, len) != static_cast<int>(len)) return false;
+
+        senderIP = udp.remoteIP();
+        senderPort = udp.remotePort();
+        storeChunk(index, len);
+        return status == RECEIVING;
+    }
+
+    void receive(unsigned long now) {
+        for (uint8_t i = 0; i < UDP_BATCH_BUDGET && status == RECEIVING; i++) {
+            int packetSize = udp.parsePacket();
+            if (packetSize <= 0) break;
+
+            if (receivePacket(packetSize, now)) lastChunk = now;
+            udp.flush();
+        }
+        if (status != RECEIVING) return;
+
+        if (chunksReceived == chunkCount) {
+            DEBUG_PRINTLN("[MULTICAST] All chunks received, verifying");
+            br_sha256_init(&hash);
+            verifyOffset = 0;
+            status = VERIFYING;
+            return;
+        }
+
+        // Quiet group: the pass is over (or we missed its END), ask for the gaps
+        if (nextNack == 0 && chunksReceived > 0 && now - lastChunk > OTA_MC_QUIET_TIME) {
+            scheduleNack(now, 0);
+        }
+        if (nextNack != 0 && static_cast<long>(now - nextNack) >= 0) {
+            sendNack();
+            scheduleNack(now, OTA_MC_NACK_INTERVAL);
+        }
+    }
+
+    void verify() {
+        uint32_t remaining = offer.imageSize - verifyOffset;
+        size_t len = min(static_cast<size_t>(remaining), sizeof(buffer.bytes));
+
+        if (!ESP.flashRead(startAddress + verifyOffset, buffer.words, sizeof(buffer.words))) {
+            fail("Flash read failed");
+            return;
+        }
+        br_sha256_update(&hash, buffer.bytes, len);
+        verifyOffset += len;
+        if (verifyOffset < offer.imageSize) return;
+
+        uint8_t digest[32];
+        br_sha256_out(&hash, digest);
+        if (memcmp(digest, offer.sha256, sizeof(digest)) != 0) {
+            fail("SHA-256 mismatch");
+            return;
+        }
+
+        // Same command Updater::end() leaves for the bootloader
+        eboot_command command;
+        memset(&command, 0, sizeof(command));
+        command.action = ACTION_COPY_RAW;
+        command.args[0] = startAddress;
+        command.args[1] = 0;
+        command.args[2] = offer.imageSize;
+        eboot_command_write(&command);
+
+        sendControl(OTA_MC_DONE, nullptr, 0);
+        DEBUG_PRINTLN("[MULTICAST] ✓ Image verified and armed");
+        status = COMPLETE;
+        finish();
+    }
+
+public:
+    MulticastImage()
+        : offer{},
+          status(IDLE),
+          error(nullptr),
+          startAddress(0),
+          chunkCount(0),
+          chunksReceived(0),
+          have{},
+          erased{},
+          senderPort(0),
+          lastChunk(0),
+          nextNack(0),
+          hash{},
+          verifyOffset(0) {}
+
+    void begin(const MulticastOffer& next) {
+        cancel();
+        offer = next;
+        error = nullptr;
+        chunkCount = offer.chunkCount();
+        chunksReceived = 0;
+        memset(have, 0, sizeof(have));
+        memset(erased, 0, sizeof(erased));
+        senderIP = IPAddress();
+        lastChunk = millis();
+        nextNack = 0;
+        status = RECEIVING;
+
+        // Place the image where Updater would: right below the filesystem
+        uint32_t rounded = (offer.imageSize + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+        uint32_t sketchEnd = (ESP.getSketchSize() + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+        startAddress = FS_PHYS_ADDR - rounded;
+        if (chunkCount > OTA_MC_MAX_CHUNKS || rounded > FS_PHYS_ADDR || startAddress < sketchEnd) {
+            fail("Image does not fit the update partition");
+            return;
+        }
+
+        if (!udp.beginMulticast(WiFi.localIP(), offer.group, offer.port)) {
+            fail("Could not join the group");
+            return;
+        }
+        WiFi.setSleepMode(WIFI_NONE_SLEEP);   // Modem sleep drops group traffic between beacons
+
+        DEBUG_PRINTF("[MULTICAST] Joined %s:%d, session %u, %u chunks\n",
+                   offer.group.toString().c_str(), offer.port, offer.session, chunkCount);
+    }
+
+    void cancel() {
+        if (status != RECEIVING && status != VERIFYING) return;
+        finish();                         // Without the eboot command the copy is ignored
+        status = IDLE;
+    }
+
+    // Drain the group socket, or hash one block once everything is in
+    Status poll() {
+        if (status == RECEIVING) {
+            receive(millis());
+        } else if (status == VERIFYING) {
+            verify();
+        }
+        return status;
+    }
+
+    [[nodiscard]] Status getStatus() const { return status; }
+    [[nodiscard]] const char* getError() const { return error; }
+    [[nodiscard]] uint16_t getChunksReceived() const { return chunksReceived; }
+
+    [[nodiscard]] uint8_t getPercent() const {
+        return chunkCount > 0 ? static_cast<uint8_t>((static_cast<uint32_t>(chunksReceived) * 100) / chunkCount) : 0;
+    }
+};
+
+#endif // MULTICAST_IMAGE_H
@@ -0,0 +1,155 @@
+#ifndef NETWORK_CLOCK_H
+#define NETWORK_CLOCK_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** NETWORK CLOCK - A time base shared by every lamp on the LAN
+** ============================================================================
+**
+** Strategies are pure functions of the time they are given. So two lamps
+** that render against the same clock play the same animation in phase. We
+** don't need any command traffic for that. Network time is local millis()
+** plus an offset, estimated from the clocks we hear:
+**
+**   - the app's, sent with CMD_SYNC_CLOCK (rank 0, always preferred);
+**   - other lamps', carried by every heartbeat they broadcast (time and
+**     rank, see HB_FIELD_CLOCK). A lamp's rank is its chip ID.
+**
+** Each lamp follows the lowest-ranked source it hears directly, as long as
+** that rank is below its own. Otherwise it leads. Ranks strictly decrease
+** along every chain, so there is no loop. What a lamp broadcasts is its
+** network time. If the leader goes quiet for CLOCK_SOURCE_TIMEOUT, the next
+** lamp down already carries its time and takes over without a jump.
+**
+** A one-way sample is the source's time minus the network delay. The
+** estimate therefore jumps up to a sample that reads ahead of it (less
+** delay) and only creeps down to one that reads behind. Crystal drift
+** (tens of ppm) is measured over at least CLOCK_DRIFT_SPAN and extrapolated
+** between samples. Rendering never sees a correction as a jump. The offset
+** it uses slews toward the estimate at 1 ms per CLOCK_SLEW_DIVISOR ms, and
+** only steps for errors above CLOCK_STEP_THRESHOLD, such as the first sync.
+**/
+class NetworkClock {
+public:
+    static constexpr uint32_t APP_RANK = 0;
+
+private:
+    uint32_t rank;                        // Ours
+    uint32_t sourceRank;                  // Followed source; == rank while leading
+    bool synced;                          // Estimate is valid
+
+    int32_t estimate;                     // Network - local (ms) at `reference`
+    unsigned long reference;
+    int32_t drift;                        // d(offset)/d(local), 2^-24 units
+    int32_t anchorOffset;                 // Start of the drift measurement
+    unsigned long anchorTime;
+
+    int32_t applied;                      // Offset in use, slewed toward the estimate
+    unsigned long lastRead;
+    unsigned long lastHeard;
+
+    static constexpr int32_t MAX_DRIFT = static_cast<int32_t>((static_cast<int64_t>(CLOCK_MAX_DRIFT_PPM) << 24) / 1000000);
+
+    [[nodiscard]] int32_t offsetAt(unsigned long local) const {
+        int64_t elapsed = static_cast<int32_t>(local - reference);
+        return estimate + static_cast<int32_t>((elapsed * drift) >> 24);
+    }
+
+    void restart(uint32_t newSource) {
+        sourceRank = newSource;
+        synced = false;
+        drift = 0;
+    }
+
+    // Free-run on the current estimate: the group now follows our crystal
+    void lead(unsigned long local) {
+        DEBUG_PRINTF("[CLOCK] Source %08X silent, leading\n", sourceRank);
+        estimate = offsetAt(local);
+        reference = local;
+        drift = 0;
+        sourceRank = rank;
+    }
+
+    void measureDrift(unsigned long local) {
+        unsigned long span = local - anchorTime;
+        if (span < CLOCK_DRIFT_SPAN) return;
+
+        int64_t measured = (static_cast<int64_t>(estimate - anchorOffset) << 24) / static_cast<int64_t>(span);
+        measured = constrain(measured, -MAX_DRIFT, MAX_DRIFT);
+        drift = static_cast<int32_t>((drift + measured) / 2);
+
+        anchorOffset = estimate;
+        anchorTime = local;
+    }
+
+public:
+    explicit NetworkClock(uint32_t ownRank)
+        : rank(ownRank),
+          sourceRank(ownRank),
+          synced(false),
+          estimate(0),
+          reference(0),
+          drift(0),
+          anchorOffset(0),
+          anchorTime(0),
+          applied(0),
+          lastRead(0),
+          lastHeard(0) {}
+
+    /**
+     * A clock reading from `sourceRank`, received at local time `local`.
+     * Returns false if we don't follow that source.
+     */
+    bool observe(uint32_t remoteTime, uint32_t remoteRank, unsigned long local) {
+        if (remoteRank >= rank) return false;             // We lead it (or it is us)
+
+        bool following = sourceRank != rank;
+        if (following && remoteRank > sourceRank) return false;
+        if (remoteRank != sourceRank) {
+            DEBUG_PRINTF("[CLOCK] Following %08X\n", remoteRank);
+            restart(remoteRank);
+        }
+
+        int32_t sample = static_cast<int32_t>(remoteTime - local);
+        if (!synced) {
+            estimate = sample;
+            anchorOffset = sample;
+            anchorTime = local;
+            synced = true;
+        } else {
+            int32_t predicted = offsetAt(local);
+            int32_t error = sample - predicted;
+            estimate = error > 0 ? sample : predicted + error / 4;
+            measureDrift(local);
+        }
+        reference = local;
+        lastHeard = local;
+
+        if (abs(estimate - applied) > CLOCK_STEP_THRESHOLD) {
+            DEBUG_PRINTF("[CLOCK] Stepped by %ld ms\n", static_cast<long>(estimate - applied));
+            applied = estimate;
+        }
+        return true;
+    }
+
+    // Network time at local time `local`; call with non-decreasing times
+    uint32_t now(unsigned long local) {
+        if (sourceRank != rank && local - lastHeard > CLOCK_SOURCE_TIMEOUT) lead(local);
+
+        int32_t target = synced ? offsetAt(local) : 0;
+        int32_t step = static_cast<int32_t>((local - lastRead) / CLOCK_SLEW_DIVISOR) + 1;
+        applied += constrain(target - applied, -step, step);
+        lastRead = local;
+        return static_cast<uint32_t>(local + applied);
+    }
+
+    [[nodiscard]] uint32_t getRank() const { return rank; }
+    [[nodiscard]] uint32_t getSourceRank() const { return sourceRank; }
+    [[nodiscard]] bool isLeader() const { return sourceRank == rank; }
+    [[nodiscard]] int32_t getDriftPpm() const { return static_cast<int32_t>((static_cast<int64_t>(drift) * 1000000) >> 24); }
+};
+
+#endif // NETWORK_CLOCK_H
@@ -0,0 +1,148 @@
+#ifndef NETWORK_SCAN_H
+#define NETWORK_SCAN_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** NETWORK SCAN - Known access points in range, strongest first
+** ============================================================================
+**
+** An asynchronous scan (WiFi.scanNetworks(true)) takes ~2 s, during which the
+** loop keeps running. poll() is called until the scan completes. It then
+** matches every access point found against the stored SSIDs and keeps the
+** SCAN_MAX_CANDIDATES strongest matches with their BSSID and channel. Each
+** AP of a site that runs several for one SSID is kept separately.
+** SearchingState connects to the candidates in order, straight to the BSSID
+** on its channel, without the SDK scanning again.
+**
+** The results are reused for SCAN_CACHE_TTL, so a lamp that drops off Wi-Fi
+** and comes straight back does not rescan. Records are read with
+** getScanInfoByIndex(), so no String is built.
+**/
+struct ScanCandidate {
+    uint8_t network;                      // Index of the stored network
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t bssid[6];
+};
+
+class NetworkScan {
+public:
+    enum Status : uint8_t {
+        IDLE,
+        RUNNING,
+        COMPLETE                          // Candidates ready (possibly none)
+    };
+
+private:
+    ScanCandidate candidates[SCAN_MAX_CANDIDATES];
+    uint8_t count;
+    uint8_t nextCandidate;
+    Status status;
+    unsigned long completedAt;
+
+    // Insert by descending RSSI, dropping the weakest when full
+    void insert(const ScanCandidate& candidate) {
+        uint8_t pos = count;
+        while (pos > 0 && candidates[pos - 1].rssi < candidate.rssi) pos--;
+        if (pos >= SCAN_MAX_CANDIDATES) return;
+
+        uint8_t last = count < SCAN_MAX_CANDIDATES ? count : SCAN_MAX_CANDIDATES - 1;
+        for (uint8_t i = last; i > pos; i--) candidates[i] = candidates[i - 1];
+        candidates[pos] = candidate;
+        if (count < SCAN_MAX_CANDIDATES) count++;
+    }
+
+    void collect(int found, const char (*ssids)[33], uint8_t networkCount) {
+        for (int i = 0; i < found; i++) {
+            const bss_info* info = WiFi.getScanInfoByIndex(i);
+            if (!info) continue;
+
+            for (uint8_t n = 0; n < networkCount; n++) {
+                size_t len = strlen(ssids[n]);
+                if (len != info->ssid_len || memcmp(ssids[n], info->ssid, len) != 0) continue;
+
+                ScanCandidate candidate;
+                candidate.network = n;
+                candidate.rssi = info->rssi;
+                candidate.channel = info->channel;
+                memcpy(candidate.bssid, info->bssid, sizeof(candidate.bssid));
+                insert(candidate);
+                break;
+            }
+        }
+    }
+
+public:
+    NetworkScan()
+        : candidates{},
+          count(0),
+          nextCandidate(0),
+          status(IDLE),
+          completedAt(0) {}
+
+    void start() {
+        count = 0;
+        nextCandidate = 0;
+        status = RUNNING;
+        WiFi.scanNetworks(true, false);   // Async; hidden networks cannot be matched
+        DEBUG_PRINTLN("[SCAN] Scanning for known networks...");
+    }
+
+    // Check on a running scan; rank the results once it is done
+    Status poll(const char (*ssids)[33], uint8_t networkCount) {
+        if (status != RUNNING) return status;
+
+        int8_t found = WiFi.scanComplete();
+        if (found == WIFI_SCAN_RUNNING) return status;
+
+        if (found > 0) collect(found, ssids, networkCount);
+        WiFi.scanDelete();                // Frees the SDK's result list
+
+        status = COMPLETE;
+        completedAt = millis();
+        DEBUG_PRINTF("[SCAN] %d APs in range, %u known\n", found > 0 ? found : 0, count);
+        for (uint8_t i = 0; i < count; i++) {
+            DEBUG_PRINTF("[SCAN]   #%u '%s' ch %u, %d dBm\n", i, ssids[candidates[i].network],
+                       candidates[i].channel, candidates[i].rssi);
+        }
+        return status;
+    }
+
+    // Hand out the candidates best first; false once all have been tried
+    bool next(ScanCandidate& out) {
+        if (status != COMPLETE || nextCandidate >= count) return false;
+        out = candidates[nextCandidate++];
+        return true;
+    }
+
+    // Completed recently enough to connect from without rescanning
+    [[nodiscard]] bool isFresh(unsigned long now) const {
+        return status == COMPLETE && now - completedAt < SCAN_CACHE_TTL;
+    }
+
+    [[nodiscard]] Status getStatus() const { return status; }
+
+    // Start over from the strongest candidate (e.g. on the next search)
+    void rewind() { nextCandidate = 0; }
+
+    void clear() {
+        count = 0;
+        nextCandidate = 0;
+        status = IDLE;
+    }
+
+    // Network `index` moved to the front of the stored list; follow it
+    void promote(uint8_t index) {
+        for (uint8_t i = 0; i < count; i++) {
+            uint8_t& network = candidates[i].network;
+            if (network == index) network = 0;
+            else if (network < index) network++;
+        }
+    }
+};
+
+#endif // NETWORK_SCAN_H
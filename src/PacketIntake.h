@@ -0,0 +1,91 @@
+#ifndef PACKET_INTAKE_H
+#define PACKET_INTAKE_H
+
+#include "States.h"
+#include <WiFiUdp.h>
+#include "Config.h"
+#include "Profiler.h"
+
+/**
+** ============================================================================
+** PACKET INTAKE - Drain queued UDP datagrams in bounded batches
+** ============================================================================
+**
+** Reading one datagram per loop caps command intake at the loop rate, so a
+** burst from the app queues up in lwIP and plays back as visible lag.
+** drain() hands every waiting datagram to the state's handleCommand(), up to
+** a per-call budget so a flood cannot starve rendering or the Wi-Fi stack.
+**
+** Datagrams are read into the caller's buffer, which is the manager's one
+** packet buffer (LuminaStateManager::receiveCommands()) rather than 256
+** bytes of stack under every handler. handleCommand() gets views into it.
+**
+** A state can take a datagram straight off the socket via receiveDirect()
+** (large payloads such as pixel frames skip the copy into the intake buffer).
+**
+** Draining stops early if a command causes a state transition: the old state
+** may already be gone, so the caller must check getCurrentState() before
+** touching its own members again.
+**/
+struct IntakeStats {
+    uint16_t received;                    // Datagrams handed to the state
+    uint16_t coalesced;                   // Commands superseded later in the same batch
+    uint16_t dropped;                     // Empty, oversized or unreadable datagrams
+
+    IntakeStats() : received(0), coalesced(0), dropped(0) {}
+
+    void accumulate(const IntakeStats& other) {
+        received += other.received;
+        coalesced += other.coalesced;
+        dropped += other.dropped;
+    }
+};
+
+namespace PacketIntake {
+    constexpr size_t BUFFER_SIZE = 256;
+
+    inline IntakeStats drain(WiFiUDP& udp, StateManager* manager, LuminaState* state,
+                             uint8_t (&buffer)[BUFFER_SIZE], uint8_t budget = UDP_BATCH_BUDGET) {
+        IntakeStats stats;
+#if PROFILE_ENABLED
+        uint32_t start = Profiler::now();
+#endif
+
+        for (uint8_t i = 0; i < budget; i++) {
+            int packetSize = udp.parsePacket();
+            if (packetSize <= 0) break;
+
+            if (state->receiveDirect(udp, packetSize)) {
+                stats.received++;
+                continue;
+            }
+
+            // The next parsePacket() discards whatever we leave unread
+            if (packetSize > static_cast<int>(sizeof(buffer))) {
+                stats.dropped++;
+                continue;
+            }
+
+            int len = udp.read(buffer, sizeof(buffer));
+            if (len <= 0) {
+                stats.dropped++;
+                continue;
+            }
+
+            stats.received++;
+            state->handleCommand(buffer[0], &buffer[1], len - 1);
+
+            if (manager->getCurrentState() != state) break;
+        }
+
+#if PROFILE_ENABLED
+        // Empty polls would swamp the histogram; only time batches with work
+        if (stats.received + stats.dropped > 0) {
+            manager->getProfiler()->record(PROFILE_INTAKE, Profiler::now() - start);
+        }
+#endif
+        return stats;
+    }
+}
+
+#endif // PACKET_INTAKE_H
@@ -0,0 +1,78 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "FrameBuffer.h"
+#include "Waveform.h"
+
+/**
+** ============================================================================
+** PALETTE - 256-entry color lookup, built when the scene changes
+** ============================================================================
+**
+** Per-pixel strategies map each pixel to a palette index and look it up,
+** instead of working out its color every frame. Each pixel has a fixed
+** phase offset along the frame (FrameBuffer::pixelPhase()). A frame adds one shift to
+** every offset, so drawing is an add and a 3-byte copy per pixel whatever
+** the effect. Bands, gradients and blends cost something only when the
+** palette is built, which happens in the strategy's constructor or
+** configure(), once per command.
+**
+** Usage:
+**   palette.gradient(colors, 3);                    // On a new scene
+**   palette.draw(frame, Waveform::phase<8000>(time) >> 8);
+**/
+class Palette {
+public:
+    static constexpr uint16_t SIZE = 256;
+
+private:
+    uint8_t rgb[SIZE * 3];
+
+    void set(uint16_t index, const Color& c) {
+        uint8_t* p = &rgb[index * 3];
+        p[0] = c.r;
+        p[1] = c.g;
+        p[2] = c.b;
+    }
+
+public:
+    Palette() : rgb{} {}
+
+    // Hard-edged bands in order, `count` equal runs of the palette
+    void bands(const Color* colors, uint8_t count) {
+        for (uint16_t i = 0; i < SIZE; i++) {
+            set(i, colors[(i * count) >> 8]);
+        }
+    }
+
+    // Smooth blend through the colors and back to the first, so it wraps
+    // without a seam
+    void gradient(const Color* colors, uint8_t count) {
+        for (uint16_t i = 0; i < SIZE; i++) {
+            uint16_t position = i * count;            // Segment in the high byte
+            const Color& from = colors[position >> 8];
+            const Color& to = colors[((position >> 8) + 1) % count];
+            Waveform::Level amount = position & 0xFF;
+            set(i, Color(Waveform::lerp8(from.r, to.r, amount),
+                         Waveform::lerp8(from.g, to.g, amount),
+                         Waveform::lerp8(from.b, to.b, amount)));
+        }
+    }
+
+    [[nodiscard]] Color at(uint8_t index) const {
+        const uint8_t* p = &rgb[index * 3];
+        return Color(p[0], p[1], p[2]);
+    }
+
+    // Pixel i = entry pixelPhase(i) + shift (wrapping)
+    void draw(FrameBuffer* frame, uint8_t shift) const {
+        uint8_t* out = frame->data();
+        for (uint16_t i = 0; i < frame->length(); i++) {
+            memcpy(out + i * 3, &rgb[static_cast<uint8_t>(frame->pixelPhase(i) + shift) * 3], 3);
+        }
+    }
+};
+
+#endif // PALETTE_H
@@ -0,0 +1,61 @@
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** POWER GOVERNOR - Keep the LED ring inside a current budget
+** ============================================================================
+**
+** A full-white frame on 16 WS2812Bs pulls close to 1 A through the MT3608,
+** and a longer strip far more. A tired cell can't supply that without
+** browning out the ESP8266. Before each push, FrameBuffer::show() sums the
+** frame's channel values, estimates the current at the requested
+** brightness, and pushes at a lower brightness if that would exceed the
+** budget. The frame itself and the user's brightness setting are left
+** alone.
+**
+** The budget is the user's (CMD_SET_POWER_BUDGET, persisted) or
+** POWER_BUDGET_MAX. Below POWER_DERATE_PERCENT it is also derated toward
+** POWER_BUDGET_MIN as the battery empties.
+**/
+namespace PowerGovernor {
+    // Draw of `pixels` LEDs with every channel off
+    constexpr uint16_t idleMilliamps(uint16_t pixels) {
+        return pixels * LED_IDLE_MA;
+    }
+
+    // LED current for a frame of `pixels` whose channels sum to channelSum, at a brightness
+    inline uint16_t estimateMilliamps(uint32_t channelSum, uint8_t brightness, uint16_t pixels) {
+        return static_cast<uint16_t>(idleMilliamps(pixels) + channelSum * brightness * LED_CHANNEL_MA / (255UL * 255UL));
+    }
+
+    // Highest brightness up to `requested` that keeps the frame within limitMa
+    inline uint8_t limitBrightness(uint32_t channelSum, uint8_t requested, uint16_t limitMa, uint16_t pixels) {
+        if (limitMa == 0) return requested;              // Unlimited
+
+        uint16_t idle = idleMilliamps(pixels);
+        uint16_t estimate = estimateMilliamps(channelSum, requested, pixels);
+        if (estimate <= limitMa) return requested;
+        if (limitMa <= idle) return 0;
+
+        // Current above idle scales linearly with brightness
+        return static_cast<uint8_t>(static_cast<uint32_t>(requested) * (limitMa - idle) / (estimate - idle));
+    }
+
+    // Budget for the LEDs: the requested budget (0 = default), derated on a low battery
+    inline uint16_t budgetFor(uint16_t requestedMa, uint8_t batteryPercent) {
+        uint16_t budget = requestedMa > 0 ? requestedMa : POWER_BUDGET_MAX;
+
+        if (batteryPercent < POWER_DERATE_PERCENT) {
+            uint16_t derated = POWER_BUDGET_MIN +
+                               static_cast<uint32_t>(POWER_BUDGET_MAX - POWER_BUDGET_MIN) * batteryPercent / POWER_DERATE_PERCENT;
+            budget = min(budget, derated);
+        }
+        return budget;
+    }
+}
+
+#endif // POWER_GOVERNOR_H
@@ -0,0 +1,194 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** PROFILER - Cycle-count timing of the hot paths, readable over UDP
+** ============================================================================
+**
+** Each probe reads the CPU cycle counter (ESP.getCycleCount(), a single
+** register read) on entry and exit. The difference goes into that section's
+** running count/sum/min/max and into a log-scale histogram: two buckets per
+** power of two, so p99 is accurate to within 50%. That is precise enough to
+** spot a regression. A probe costs a few dozen instructions and no heap;
+** the whole table is a fixed ~900 bytes.
+**
+** CMD_GET_PROFILE returns a snapshot (see encode()), in cycles; the packet
+** carries the CPU clock so the app can convert. The probes stay in
+** production builds; -DPROFILE_ENABLED=0 compiles them out.
+**
+** The packet also carries the boot timeline: the millis() at which each
+** start-up phase was first reached (see LuminaStateManager::markBoot()),
+** so boot-to-controllable can be measured on a lamp in the field.
+**/
+enum ProfileSection : uint8_t {
+    PROFILE_LOOP,                         // One LuminaStateManager::update() pass
+    PROFILE_STATE_UPDATE,                 // LuminaState::update()
+    PROFILE_RENDER,                       // LightingEngine::render()
+    PROFILE_SHOW,                         // FrameBuffer::show()
+    PROFILE_INTAKE,                       // PacketIntake::drain() that found packets
+    PROFILE_HEARTBEAT,                    // Build and send one heartbeat
+    PROFILE_SECTIONS
+};
+
+enum BootMark : uint8_t {
+    BOOT_START,                           // LuminaStateManager::begin() entered
+    BOOT_SETTINGS,                        // Settings, script and strip layout loaded
+    BOOT_FIRST_FRAME,                     // Saved scene (or dark) on the strips
+    BOOT_WIFI_START,                      // Association or scan started
+    BOOT_ASSOCIATED,                      // Station has its IP
+    BOOT_CONNECTED,                       // Listening for commands
+    BOOT_DEFERRED,                        // Banner, heap baseline and battery burst done
+    BOOT_MARKS
+};
+
+class Profiler {
+private:
+    static constexpr uint8_t BUCKETS = 64;
+
+    struct Section {
+        uint32_t count;
+        uint32_t minCycles;
+        uint32_t maxCycles;
+        uint64_t sumCycles;
+        uint16_t buckets[BUCKETS];        // Halved together when one saturates
+    };
+
+    Section sections[PROFILE_SECTIONS];
+    uint32_t bootMs[BOOT_MARKS];          // 0 = not reached yet
+
+    // 0, 1, then two buckets per octave: [2^n, 1.5*2^n) and [1.5*2^n, 2^(n+1))
+    static uint8_t bucketFor(uint32_t cycles) {
+        if (cycles < 2) return static_cast<uint8_t>(cycles);
+        uint8_t octave = static_cast<uint8_t>(31 - __builtin_clz(cycles));
+        return static_cast<uint8_t>(octave * 2 + ((cycles >> (octave - 1)) & 1));
+    }
+
+    // Largest value that lands in a bucket
+    static uint32_t bucketLimit(uint8_t bucket) {
+        if (bucket < 2) return bucket;
+        uint8_t octave = bucket / 2;
+        uint64_t low = (1ULL << octave) | (static_cast<uint64_t>(bucket & 1) << (octave - 1));
+        return static_cast<uint32_t>(low + (1ULL << (octave - 1)) - 1);
+    }
+
+    static void halve(Section& s) {
+        for (uint16_t& b : s.buckets) b >>= 1;
+    }
+
+    static uint32_t percentile(const Section& s, uint8_t percent) {
+        uint32_t total = 0;
+        for (uint16_t b : s.buckets) total += b;
+        if (total == 0) return 0;
+
+        uint32_t rank = (total * percent + 99) / 100;  // Nearest-rank, rounded up
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < BUCKETS; i++) {
+            seen += s.buckets[i];
+            if (seen >= rank) return min(bucketLimit(i), s.maxCycles);
+        }
+        return s.maxCycles;
+    }
+
+    static uint8_t* put32(uint8_t* p, uint32_t v) {
+        p[0] = v;
+        p[1] = v >> 8;
+        p[2] = v >> 16;
+        p[3] = v >> 24;
+        return p + 4;
+    }
+
+public:
+    // Per section: [id, count u32, min u32, avg u32, max u32, p99 u32]
+    static constexpr size_t SECTION_BYTES = 21;
+    static constexpr size_t PACKET_SIZE = 4 + SECTION_BYTES * PROFILE_SECTIONS + 1 + 4 * BOOT_MARKS;
+
+    Profiler() : bootMs{} { reset(); }
+
+    static inline uint32_t now() { return ESP.getCycleCount(); }
+
+    inline void record(ProfileSection id, uint32_t cycles) {
+        Section& s = sections[id];
+        s.count++;
+        s.sumCycles += cycles;
+        if (cycles < s.minCycles) s.minCycles = cycles;
+        if (cycles > s.maxCycles) s.maxCycles = cycles;
+        if (++s.buckets[bucketFor(cycles)] == UINT16_MAX) halve(s);
+    }
+
+    // Sections only: the boot timeline is recorded once per power-on
+    void reset() {
+        for (Section& s : sections) {
+            s = Section{};
+            s.minCycles = UINT32_MAX;
+        }
+    }
+
+    // First time only; returns false if the mark was already set
+    bool markBoot(BootMark mark, uint32_t ms) {
+        if (bootMs[mark] != 0) return false;
+        bootMs[mark] = ms ? ms : 1;
+        return true;
+    }
+
+    [[nodiscard]] uint32_t getBootMark(BootMark mark) const { return bootMs[mark]; }
+
+    /**
+     * Snapshot packet (little-endian):
+     * [STATUS_PROFILE, PROFILE_VERSION, sections, cpuMHz] + one entry per
+     * section + [marks, ms u32 per BootMark]. avg and p99 are 0 for a
+     * section that has not run yet, ms is 0 for a phase not reached yet.
+     */
+    size_t encode(uint8_t* out) const {
+        uint8_t* p = out;
+        *p++ = STATUS_PROFILE;
+        *p++ = PROFILE_VERSION;
+        *p++ = PROFILE_SECTIONS;
+        *p++ = static_cast<uint8_t>(ESP.getCpuFreqMHz());
+
+        for (uint8_t id = 0; id < PROFILE_SECTIONS; id++) {
+            const Section& s = sections[id];
+            *p++ = id;
+            p = put32(p, s.count);
+            p = put32(p, s.count ? s.minCycles : 0);
+            p = put32(p, s.count ? static_cast<uint32_t>(s.sumCycles / s.count) : 0);
+            p = put32(p, s.maxCycles);
+            p = put32(p, percentile(s, 99));
+        }
+
+        *p++ = BOOT_MARKS;
+        for (uint32_t ms : bootMs) p = put32(p, ms);
+        return p - out;
+    }
+};
+
+/**
+ * Times the rest of the enclosing block into `section`:
+ *   PROFILE_SCOPE(manager->getProfiler(), PROFILE_HEARTBEAT);
+ */
+class ProfileScope {
+private:
+    Profiler* profiler;
+    ProfileSection section;
+    uint32_t start;
+
+public:
+    ProfileScope(Profiler* p, ProfileSection id) : profiler(p), section(id), start(Profiler::now()) {}
+    ~ProfileScope() { profiler->record(section, Profiler::now() - start); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#if PROFILE_ENABLED
+  #define PROFILE_JOIN_(a, b) a##b
+  #define PROFILE_JOIN(a, b)  PROFILE_JOIN_(a, b)
+  #define PROFILE_SCOPE(profiler, section) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(profiler, section)
+#else
+  #define PROFILE_SCOPE(profiler, section)
+#endif
+
+#endif // PROFILER_H
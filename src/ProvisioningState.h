@@ -6,7 +6,14 @@
 #include <WiFiUdp.h>
 
 #include "Config.h"
+#include "CommandTable.h"
+#include "EffectSequence.h"
+#include "FrameBuffer.h"
+#include "LightingEngine.h"
+#include "PacketIntake.h"
+#include "Scheduler.h"
 #include "SearchingState.h"
+#include "SettingsStore.h"
 
 // ============================================================================
 // PROVISIONING STATE - Device acts as Access Point for setup
@@ -14,31 +21,28 @@
 class ProvisioningState : public LuminaState {
 private:
     WiFiUDP udp;
-    unsigned long lastBroadcast;
     uint8_t orangePhase;
-    unsigned long lastAnimUpdate;
+    Scheduler::TaskId animationTask;
     
     void updateOrangeAnimation() {
-        if (millis() - lastAnimUpdate < 100) return;
-        lastAnimUpdate = millis();
+        if (manager->getEffects()->isPlaying()) return; // The boot rainbow goes first
         
         // Rotating orange segments
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        leds->clear();
+        FrameBuffer* frame = manager->getFrameBuffer();
+        frame->clear();
+        uint16_t pixels = frame->length();
+        if (pixels == 0) return;
         
         for (int i = 0; i < 4; i++) {
-            int pos = (orangePhase + i * 4) % LED_COUNT;
-            leds->setPixelColor(pos, Colors::PROVISIONING.to32bit());
+            int pos = (orangePhase + i * pixels / 4) % pixels;
+            frame->setPixel(pos, Colors::PROVISIONING);
         }
         
-        leds->show();
-        orangePhase = (orangePhase + 1) % LED_COUNT;
+        frame->show();
+        orangePhase = (orangePhase + 1) % pixels;
     }
     
     void broadcastPresence() {
-        if (millis() - lastBroadcast < 2000) return; // Every 2 seconds
-        lastBroadcast = millis();
-        
         // Broadcast announcement packet so app can discover us
         uint8_t packet[64];
         packet[0] = STATUS_STATE;
@@ -54,13 +58,94 @@ private:
         
         DEBUG_PRINTLN("[PROVISION] Broadcasting presence...");
     }
+    
+    void receiveCommands() {
+        IntakeStats batch = manager->receiveCommands(udp);
+        if (manager->getCurrentState() != this) return;
+        
+        if (batch.dropped > 0) {
+            DEBUG_PRINTF("[PROVISION] Dropped %u malformed packets\n", batch.dropped);
+        }
+    }
+
+    // ========================================================================
+    // COMMAND HANDLERS - payload lengths are checked against COMMANDS first
+    // ========================================================================
+    void onProvision(CommandView payload) {
+        WifiNetwork network;              // Parsed in place; no String, so no heap
+        if (!network.parse(payload.data, payload.len)) {
+            DEBUG_PRINTLN("[PROVISION] ✗ Invalid provision data");
+            return;
+        }
+        
+        DEBUG_PRINTF("[PROVISION] Received credentials:\n  SSID: %s\n  Pass: %s\n", 
+                   network.ssid, 
+                   network.password[0] ? "***" : "(empty)");
+        
+        // Save credentials
+        if (!manager->saveCredentials(network.ssid, network.password)) return;
+        
+        // Send success response
+        uint8_t response[2] = {STATUS_STATE, STATE_SEARCHING};
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write(response, 2);
+        udp.endPacket();
+        
+        DEBUG_PRINTLN("[PROVISION] ✓ Credentials saved, rebooting...");
+        
+        // Flash green to indicate success, then reboot
+        manager->getScheduler()->cancel(animationTask);
+        manager->getEffects()->play(Effects::SUCCESS_FLASH, manager, [](void* mgr) {
+            static_cast<StateManager*>(mgr)->reboot();
+        });
+    }
+    
+    void onGetStatus(CommandView) {
+        // Send device info
+        uint8_t response[32];
+        response[0] = STATUS_STATE;
+        response[1] = STATE_PROVISIONING;
+        response[2] = manager->getBatteryPercent();
+        response[3] = strlen(FIRMWARE_VERSION);
+        memcpy(&response[4], FIRMWARE_VERSION, response[3]);
+        
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write(response, 4 + response[3]);
+        udp.endPacket();
+        
+        DEBUG_PRINTLN("[PROVISION] Sent status response");
+    }
+    
+    void onReset(CommandView) {
+        DEBUG_PRINTLN("[PROVISION] Factory reset requested");
+        manager->clearCredentials();
+        
+        // Send acknowledgment
+        uint8_t response[1] = {STATUS_STATE};
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write(response, 1);
+        udp.endPacket();
+        
+        manager->reboot();
+    }
+    
+    static constexpr CommandHandler<ProvisioningState> COMMANDS[] = {
+        {CMD_PROVISION,  2, &ProvisioningState::onProvision},
+        {CMD_GET_STATUS, 0, &ProvisioningState::onGetStatus},
+        {CMD_RESET,      0, &ProvisioningState::onReset},
+    };
 
 public:
     explicit ProvisioningState(StateManager* mgr) 
         : LuminaState(mgr),
-          lastBroadcast(0),
           orangePhase(0),
-          lastAnimUpdate(0) {}
+          animationTask(Scheduler::INVALID_TASK) {}
+    
+    void reset() override {
+        LuminaState::reset();
+        orangePhase = 0;
+        animationTask = Scheduler::INVALID_TASK;
+    }
     
     ~ProvisioningState() override
     {
@@ -70,18 +155,18 @@ public:
     void onEnter() override {
         stateStartTime = millis();
         DEBUG_PRINTLN("\n[PROVISION] Entering Provisioning State");
+        manager->getLighting()->setActive(false); // The orange animation takes over
         
-        // Stop any existing Wi-Fi connection
+        // Stop any existing Wi-Fi connection (WiFi.mode() below waits for
+        // the station to go down)
         WiFi.disconnect();
-        delay(100);
         
         // Create Access Point
         DEBUG_PRINTF("[PROVISION] Creating AP '%s'...\n", AP_SSID);
         WiFi.mode(WIFI_AP);
         WiFi.softAP(AP_SSID, AP_PASSWORD);
         
-        IPAddress apIP = WiFi.softAPIP();
-        DEBUG_PRINTF("[PROVISION] AP IP: %s\n", apIP.toString().c_str());
+        DEBUG_PRINTF("[PROVISION] AP IP: %s\n", WiFi.softAPIP().toString().c_str());
         
         // Start UDP listener
         if (udp.begin(UDP_PORT)) {
@@ -92,8 +177,22 @@ public:
         
         // Initialize animation
         orangePhase = 0;
-        lastAnimUpdate = millis();
-        lastBroadcast = 0;
+        
+        Scheduler* scheduler = manager->getScheduler();
+        scheduler->every(UDP_POLL_INTERVAL, [](void* self) {
+            static_cast<ProvisioningState*>(self)->receiveCommands();
+        }, this);
+        animationTask = scheduler->every(100, [](void* self) {
+            static_cast<ProvisioningState*>(self)->updateOrangeAnimation();
+        }, this);
+        scheduler->every(2000, [](void* self) { // Every 2 seconds
+            static_cast<ProvisioningState*>(self)->broadcastPresence();
+        }, this);
+        
+        // Return to searching after 5 minutes
+        scheduler->after(PROVISION_TIMEOUT, [](void* self) {
+            static_cast<ProvisioningState*>(self)->handleTimeout();
+        }, this);
     }
     
     void onExit() override {
@@ -101,30 +200,9 @@ public:
         udp.stop();
         WiFi.softAPdisconnect(true);
         
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        leds->clear();
-        leds->show();
-    }
-    
-    void update() override {
-        updateOrangeAnimation();
-        broadcastPresence();
-        
-        // Check for incoming UDP packets
-        int packetSize = udp.parsePacket();
-        if (packetSize > 0) {
-            uint8_t buffer[256];
-            int len = udp.read(buffer, sizeof(buffer));
-            
-            if (len > 0) {
-                handleCommand(buffer[0], &buffer[1], len - 1);
-            }
-        }
-        
-        // Timeout check (return to searching after 5 minutes)
-        if (hasTimedOut(PROVISION_TIMEOUT)) {
-            handleTimeout();
-        }
+        FrameBuffer* frame = manager->getFrameBuffer();
+        frame->clear();
+        frame->show();
     }
     
     void handleTimeout() override {
@@ -135,99 +213,11 @@ public:
     void handleCommand(uint8_t cmd, uint8_t* data, size_t len) override {
         DEBUG_PRINTF("[PROVISION] Received command: 0x%02X\n", cmd);
         
-        switch (cmd) {
-            case CMD_PROVISION: {
-                if (len < 2) {
-                    DEBUG_PRINTLN("[PROVISION] ✗ Invalid provision data");
-                    break;
-                }
-                
-                // Parse SSID
-                uint8_t ssidLen = data[0];
-                if (ssidLen > 32 || len < ssidLen + 2) {
-                    DEBUG_PRINTLN("[PROVISION] ✗ Invalid SSID length");
-                    break;
-                }
-                
-                String ssid = "";
-                for (int i = 0; i < ssidLen; i++) {
-                    ssid += static_cast<char>(data[1 + i]);
-                }
-                
-                // Parse Password
-                uint8_t passLen = data[1 + ssidLen];
-                if (passLen > 64 || len < ssidLen + passLen + 2) {
-                    DEBUG_PRINTLN("[PROVISION] ✗ Invalid password length");
-                    break;
-                }
-                
-                String password = "";
-                for (int i = 0; i < passLen; i++) {
-                    password += static_cast<char>(data[2 + ssidLen + i]);
-                }
-                
-                DEBUG_PRINTF("[PROVISION] Received credentials:\n  SSID: %s\n  Pass: %s\n", 
-                           ssid.c_str(), 
-                           password.length() > 0 ? "***" : "(empty)");
-                
-                // Save credentials
-                if (manager->saveCredentials(ssid, password)) {
-                    // Send success response
-                    uint8_t response[2] = {STATUS_STATE, STATE_SEARCHING};
-                    udp.beginPacket(udp.remoteIP(), udp.remotePort());
-                    udp.write(response, 2);
-                    udp.endPacket();
-                    
-                    DEBUG_PRINTLN("[PROVISION] ✓ Credentials saved, rebooting...");
-                    
-                    // Flash green to indicate success
-                    Adafruit_NeoPixel* leds = manager->getLEDs();
-                    for (int i = 0; i < LED_COUNT; i++) {
-                        leds->setPixelColor(i, Colors::CONNECTED.to32bit());
-                    }
-                    leds->show();
-                    delay(2000);
-                    
-                    manager->reboot();
-                }
-                break;
-            }
-            
-            case CMD_GET_STATUS: {
-                // Send device info
-                uint8_t response[32];
-                response[0] = STATUS_STATE;
-                response[1] = STATE_PROVISIONING;
-                response[2] = manager->getBatteryPercent();
-                response[3] = strlen(FIRMWARE_VERSION);
-                memcpy(&response[4], FIRMWARE_VERSION, response[3]);
-                
-                udp.beginPacket(udp.remoteIP(), udp.remotePort());
-                udp.write(response, 4 + response[3]);
-                udp.endPacket();
-                
-                DEBUG_PRINTLN("[PROVISION] Sent status response");
-                break;
-            }
-            
-            case CMD_RESET: {
-                DEBUG_PRINTLN("[PROVISION] Factory reset requested");
-                manager->clearCredentials();
-                
-                // Send acknowledgment
-                uint8_t response[1] = {STATUS_STATE};
-                udp.beginPacket(udp.remoteIP(), udp.remotePort());
-                udp.write(response, 1);
-                udp.endPacket();
-                
-                delay(1000);
-                manager->reboot();
-                break;
-            }
-            
-            default:
-                DEBUG_PRINTF("[PROVISION] Unknown command: 0x%02X\n", cmd);
-                break;
+        CommandTable::Result result = CommandTable::dispatch(this, COMMANDS, cmd, data, len);
+        if (result == CommandTable::TOO_SHORT) {
+            DEBUG_PRINTF("[PROVISION] ✗ Command 0x%02X too short (%u bytes)\n", cmd, len);
+        } else if (result == CommandTable::UNKNOWN) {
+            DEBUG_PRINTF("[PROVISION] Unknown command: 0x%02X\n", cmd);
         }
     }
     
@@ -235,9 +225,10 @@ public:
     uint8_t getStateCode() const override { return STATE_PROVISIONING; }
 };
 
-// Factory function
+// Factory function: one statically allocated instance, reused on every entry
 inline LuminaState* createProvisioningState(StateManager* manager) {
-    return new ProvisioningState(manager);
+    static ProvisioningState instance(manager);
+    return &instance;
 }
 
 #endif // PROVISIONING_STATE_H
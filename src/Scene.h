@@ -0,0 +1,43 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** SCENE - Serializable description of what the lamp is showing
+** ============================================================================
+**
+** A scene is the strategy id plus its parameters, in plain bytes so it can
+** be persisted as-is (see SettingsStore.h) and turned back into a strategy
+** by LightingEngine at boot.
+**/
+struct Scene {
+    uint8_t strategyId;                   // STRATEGY_* code
+    uint8_t rgb[9];                       // Up to three colors, RGB order
+
+    static Scene of(uint8_t strategyId, const Color& c1,
+                    const Color& c2 = Colors::OFF, const Color& c3 = Colors::OFF) {
+        Scene scene{};
+        scene.strategyId = strategyId;
+        scene.setColor(0, c1);
+        scene.setColor(1, c2);
+        scene.setColor(2, c3);
+        return scene;
+    }
+
+    [[nodiscard]] Color color(uint8_t index) const {
+        const uint8_t* p = &rgb[index * 3];
+        return Color(p[0], p[1], p[2]);
+    }
+
+    void setColor(uint8_t index, const Color& c) {
+        uint8_t* p = &rgb[index * 3];
+        p[0] = c.r;
+        p[1] = c.g;
+        p[2] = c.b;
+    }
+};
+
+#endif // SCENE_H
@@ -0,0 +1,163 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** COOPERATIVE SCHEDULER - Deadline-driven periodic and one-shot tasks
+** ============================================================================
+**
+** Replaces per-state millis() polling plus a fixed delay(10) in loop().
+** States register their periodic work (render, heartbeat, connection check,
+** ...) in onEnter(); the main loop runs whatever is due and then sleeps
+** exactly until the next deadline.
+**
+** Periodic tasks are fixed-rate: the next deadline is the previous deadline
+** plus the period, not "now" plus the period, so animation timing does not
+** drift with loop jitter. A task that falls a whole period behind is
+** re-anchored to now instead of firing a catch-up burst.
+**
+** Tasks are plain function pointers plus a context pointer, so registering
+** one never allocates. Captureless lambdas convert to TaskCallback:
+**
+**   scheduler->every(FADE_SPEED, [](void* self) {
+**       static_cast<ConnectedState*>(self)->render();
+**   }, this);
+**
+** The context doubles as the task owner: cancelAll(owner) removes every task
+** an object registered. The state manager does this automatically for the
+** outgoing state on every transition.
+**/
+typedef void (*TaskCallback)(void* context);
+
+class Scheduler {
+public:
+    typedef uint8_t TaskId;
+    static constexpr TaskId INVALID_TASK = 0xFF;
+
+private:
+    struct Task {
+        TaskCallback callback;
+        void* context;
+        unsigned long period;             // 0 = one-shot
+        unsigned long deadline;
+        bool active;
+    };
+
+    Task tasks[SCHEDULER_MAX_TASKS];
+
+    // Wrap-safe "a is at or before b" for millis() timestamps
+    static bool reached(unsigned long deadline, unsigned long now) {
+        return static_cast<long>(now - deadline) >= 0;
+    }
+
+    TaskId add(unsigned long period, unsigned long delayMs, TaskCallback callback, void* context) {
+        for (TaskId id = 0; id < SCHEDULER_MAX_TASKS; id++) {
+            Task& task = tasks[id];
+            if (task.active) continue;
+
+            task.callback = callback;
+            task.context = context;
+            task.period = period;
+            task.deadline = millis() + delayMs;
+            task.active = true;
+            return id;
+        }
+
+        DEBUG_PRINTLN("[SCHED] ✗ Task table full");
+        return INVALID_TASK;
+    }
+
+public:
+    Scheduler() : tasks{} {}
+
+    // ========================================================================
+    // REGISTRATION
+    // ========================================================================
+
+    // Run every `period` ms, first after `initialDelay` ms (default: next run)
+    TaskId every(unsigned long period, TaskCallback callback, void* context,
+                 unsigned long initialDelay = 0) {
+        if (period == 0) return INVALID_TASK;
+        return add(period, initialDelay, callback, context);
+    }
+
+    // Run once, `delayMs` from now
+    TaskId after(unsigned long delayMs, TaskCallback callback, void* context) {
+        return add(0, delayMs, callback, context);
+    }
+
+    void cancel(TaskId id) {
+        if (id < SCHEDULER_MAX_TASKS) tasks[id].active = false;
+    }
+
+    void cancelAll(const void* context) {
+        for (Task& task : tasks) {
+            if (task.context == context) task.active = false;
+        }
+    }
+
+    // Change a periodic task's rate; takes effect from now
+    void setPeriod(TaskId id, unsigned long period) {
+        if (id >= SCHEDULER_MAX_TASKS || !tasks[id].active || period == 0) return;
+        tasks[id].period = period;
+        tasks[id].deadline = millis() + period;
+    }
+
+    // Restart a task's countdown, e.g. to debounce a one-shot
+    void postpone(TaskId id, unsigned long delayMs) {
+        if (id < SCHEDULER_MAX_TASKS && tasks[id].active) tasks[id].deadline = millis() + delayMs;
+    }
+
+    // Make a task due on the next run() without changing its period
+    void trigger(TaskId id) {
+        if (id < SCHEDULER_MAX_TASKS && tasks[id].active) tasks[id].deadline = millis();
+    }
+
+    // ========================================================================
+    // EXECUTION
+    // ========================================================================
+
+    /**
+     * Run every task whose deadline has passed. Callbacks may register,
+     * cancel or reschedule tasks (including their own) while this runs.
+     */
+    void run(unsigned long now) {
+        for (Task& task : tasks) {
+            if (!task.active || !reached(task.deadline, now)) continue;
+
+            // Update bookkeeping before the call so the callback sees a
+            // consistent table and can cancel/reschedule itself
+            TaskCallback callback = task.callback;
+            void* context = task.context;
+
+            if (task.period == 0) {
+                task.active = false;
+            } else {
+                task.deadline += task.period;
+                if (reached(task.deadline, now)) {
+                    task.deadline = now + task.period;
+                }
+            }
+
+            callback(context);
+        }
+    }
+
+    // Milliseconds until the earliest deadline (0 = something is due now)
+    [[nodiscard]] unsigned long timeUntilNext(unsigned long now) const {
+        unsigned long wait = SCHEDULER_MAX_IDLE;
+        for (const Task& task : tasks) {
+            if (!task.active) continue;
+            if (reached(task.deadline, now)) return 0;
+
+            unsigned long remaining = task.deadline - now;
+            if (remaining < wait) wait = remaining;
+        }
+        return wait;
+    }
+};
+
+#endif // SCHEDULER_H
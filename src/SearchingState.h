@@ -5,24 +5,41 @@
 #include <ESP8266WiFi.h>
 
 #include "Config.h"
+#include "CommandTable.h"
+#include "EffectSequence.h"
+#include "FrameBuffer.h"
+#include "LightingEngine.h"
+#include "LinkCache.h"
+#include "NetworkScan.h"
+#include "Scheduler.h"
+#include "SettingsStore.h"
 #include "ProvisioningState.h"
 #include "ConnectedState.h"
 
 // ============================================================================
 // SEARCHING STATE - Attempting to connect to saved WiFi
 // ============================================================================
+// Order of attempts: the cached link of the most recent network, then every
+// known access point in range from a scan (strongest first, WIFI_ATTEMPT_TIMEOUT
+// each), then a plain begin() of the most recent network, which also finds a
+// hidden SSID, until the next scan SCAN_RETRY_DELAY later. Provisioning starts
+// once WIFI_TIMEOUT has passed and no attempt is still running.
 class SearchingState : public LuminaState {
 private:
     uint8_t pulseValue;
     bool pulseDirection;
-    unsigned long lastPulseUpdate;
-    String ssid;
-    String password;
-    unsigned long lastConnectionAttempt;
+    char ssids[WIFI_NETWORKS][33];        // NUL-terminated; no String, so no heap
+    uint8_t networkCount;
+    char password[65];                    // Of the network being tried
+    int8_t connecting;                    // Stored network being tried, -1 = none
+    bool fastPath;                        // Connecting with the cached link
+    bool pulsing;                         // No saved scene, so show the search pulse
+    NetworkScan scan;                     // Survives reset(), so a quick return skips the scan
+    Scheduler::TaskId scanTask;
+    Scheduler::TaskId timeoutTask;
     
     void updatePulseAnimation() {
-        if (millis() - lastPulseUpdate < PULSE_SPEED) return;
-        lastPulseUpdate = millis();
+        if (manager->getEffects()->isPlaying()) return; // The boot rainbow goes first
         
         // Smooth sine-wave pulse
         if (pulseDirection) {
@@ -40,83 +57,245 @@ private:
         }
         
         // Apply blue color with current pulse brightness
-        Adafruit_NeoPixel* leds = manager->getLEDs();
+        FrameBuffer* frame = manager->getFrameBuffer();
         uint8_t scaledBlue = map(pulseValue, 0, 255, 0, Colors::SEARCHING.b);
         
-        for (int i = 0; i < LED_COUNT; i++) {
-            leds->setPixelColor(i, 0, 0, scaledBlue);
+        frame->fill(Color(0, 0, scaledBlue));
+        frame->show();
+    }
+    
+    // Connect to stored network `index`; a channel of 0 lets the SDK scan for it
+    void beginNetwork(uint8_t index, int32_t channel = 0, const uint8_t* bssid = nullptr) {
+        manager->loadCredentials(index, ssids[index], sizeof(ssids[index]), password, sizeof(password));
+        connecting = index;
+        WiFi.begin(ssids[index], password, channel, bssid);
+    }
+    
+    // Run tryNextCandidate() after delayMs unless the connection comes up first.
+    // The timeout is held off until then, so an attempt always runs its course
+    void retryAfter(unsigned long delayMs) {
+        Scheduler* scheduler = manager->getScheduler();
+        scheduler->after(delayMs, [](void* self) {
+            static_cast<SearchingState*>(self)->tryNextCandidate();
+        }, this);
+        
+        unsigned long elapsed = millis() - stateStartTime;
+        unsigned long remaining = elapsed < WIFI_TIMEOUT ? WIFI_TIMEOUT - elapsed : 0;
+        unsigned long hold = delayMs + WIFI_POLL_INTERVAL; // One last status poll
+        scheduler->postpone(timeoutTask, remaining > hold ? remaining : hold);
+    }
+    
+    /**
+     * Associate directly with the cached BSSID on the cached channel, reusing
+     * the cached lease if there is one. Returns false if there is no cache.
+     * The cache always belongs to network 0, the last one connected.
+     */
+    bool beginFastPath() {
+        LinkCache cache;
+        if (!manager->loadLinkCache(cache)) return false;
+        
+        if (cache.hasLease()) {
+            WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway),
+                        IPAddress(cache.subnet), IPAddress(cache.dns));
+        }
+        beginNetwork(0, cache.channel, cache.bssid);
+        
+        DEBUG_PRINTF("[SEARCHING] Fast reconnect on channel %d%s\n",
+                   cache.channel, cache.hasLease() ? " with cached lease" : "");
+        return true;
+    }
+    
+    // The AP moved channel or is not up yet: go through the scan with DHCP.
+    // The cache is rewritten by whichever connection eventually succeeds
+    void fallBackToScan() {
+        if (WiFi.status() == WL_CONNECTED) return;
+        
+        DEBUG_PRINTLN("[SEARCHING] ✗ Fast reconnect failed, scanning");
+        fastPath = false;
+        
+        WiFi.disconnect();
+        WiFi.config(IPAddress(), IPAddress(), IPAddress()); // Back to DHCP
+        tryNextCandidate();
+    }
+    
+    void tryNextCandidate() {
+        if (WiFi.status() == WL_CONNECTED) return;
+        
+        ScanCandidate candidate;
+        if (scan.next(candidate)) {
+            DEBUG_PRINTF("[SEARCHING] Trying '%s' on channel %u (%d dBm)\n",
+                       ssids[candidate.network], candidate.channel, candidate.rssi);
+            beginNetwork(candidate.network, candidate.channel, candidate.bssid);
+            retryAfter(WIFI_ATTEMPT_TIMEOUT);
+        } else if (scan.getStatus() != NetworkScan::COMPLETE) {
+            startScan();
+        } else {
+            // Nothing known answered, or the network is hidden and never
+            // shows up in a scan: let the SDK look for the most recent one
+            DEBUG_PRINTF("[SEARCHING] No known AP reachable, looking for '%s'\n", ssids[0]);
+            scan.clear();
+            beginNetwork(0);
+            retryAfter(SCAN_RETRY_DELAY);
         }
-        leds->show();
+    }
+    
+    void startScan() {
+        WiFi.disconnect();                // A pending begin() would hold the radio
+        connecting = -1;
+        scan.start();
+        scanTask = manager->getScheduler()->every(SCAN_POLL_INTERVAL, [](void* self) {
+            static_cast<SearchingState*>(self)->pollScan();
+        }, this, SCAN_POLL_INTERVAL);
+    }
+    
+    void pollScan() {
+        if (scan.poll(ssids, networkCount) != NetworkScan::COMPLETE) return;
+        
+        manager->getScheduler()->cancel(scanTask);
+        scanTask = Scheduler::INVALID_TASK;
+        tryNextCandidate();
     }
     
     void attemptConnection() {
-        if (millis() - lastConnectionAttempt < 5000) return; // Try every 5s
-        lastConnectionAttempt = millis();
+        if (connecting < 0 || WiFi.status() != WL_CONNECTED) return;
+        
+        DEBUG_PRINTF("[SEARCHING] ✓ WiFi '%s' connected in %lu ms%s\n", ssids[connecting],
+                   millis() - stateStartTime, fastPath ? " (fast path)" : "");
+        DEBUG_PRINTF("[SEARCHING] IP: %s\n", WiFi.localIP().toString().c_str());
+        
+        // Memory safety check
+        if (manager->getFreeHeap() < MIN_FREE_HEAP) {
+            DEBUG_PRINTF("[SEARCHING] ⚠ Low memory: %d bytes\n", manager->getFreeHeap());
+        }
+        
+        manager->markBoot(BOOT_ASSOCIATED);
+        
+        // Try this network first next time, and remember the link (no-op if unchanged)
+        manager->promoteNetwork(connecting);
+        scan.promote(connecting);
+        manager->saveLinkCache(LinkCache::capture());
+        
+        // Success! Transition to ConnectedState
+        manager->transitionTo(createConnectedState(manager));
+    }
+
+    void onProvision(CommandView payload) {
+        DEBUG_PRINTLN("[SEARCHING] Received provision command");
         
-        DEBUG_PRINTF("[SEARCHING] Attempting to connect to '%s'...\n", ssid.c_str());
+        WifiNetwork network;
+        if (!network.parse(payload.data, payload.len)) return; // Invalid
         
-        if (WiFi.status() == WL_CONNECTED) {
-            DEBUG_PRINTLN("[SEARCHING] ✓ WiFi connected!");
-            DEBUG_PRINTF("[SEARCHING] IP: %s\n", WiFi.localIP().toString().c_str());
-            
-            // Success! Transition to ConnectedState
-            manager->transitionTo(createConnectedState(manager));
+        // Save and reconnect
+        if (manager->saveCredentials(network.ssid, network.password)) {
+            DEBUG_PRINTLN("[SEARCHING] New credentials saved, rebooting...");
+            manager->reboot();
         }
     }
+    
+    void onReset(CommandView) {
+        DEBUG_PRINTLN("[SEARCHING] Factory reset requested");
+        manager->clearCredentials();
+        manager->reboot();
+    }
+    
+    static constexpr CommandHandler<SearchingState> COMMANDS[] = {
+        {CMD_PROVISION, 2, &SearchingState::onProvision},
+        {CMD_RESET,     0, &SearchingState::onReset},
+    };
 
 public:
     explicit SearchingState(StateManager* mgr) 
         : LuminaState(mgr), 
           pulseValue(BRIGHTNESS_MIN), 
           pulseDirection(true),
-          lastPulseUpdate(0),
-          lastConnectionAttempt(0) {}
+          ssids{},
+          networkCount(0),
+          password{},
+          connecting(-1),
+          fastPath(false),
+          pulsing(false),
+          scanTask(Scheduler::INVALID_TASK),
+          timeoutTask(Scheduler::INVALID_TASK) {}
+    
+    void reset() override {
+        LuminaState::reset();
+        pulseValue = BRIGHTNESS_MIN;
+        pulseDirection = true;
+        memset(ssids, 0, sizeof(ssids));
+        networkCount = 0;
+        memset(password, 0, sizeof(password));
+        connecting = -1;
+        fastPath = false;
+        pulsing = false;
+        scanTask = Scheduler::INVALID_TASK;
+        timeoutTask = Scheduler::INVALID_TASK;
+    }
     
     void onEnter() override {
         stateStartTime = millis();
         DEBUG_PRINTLN("\n[SEARCHING] Entering Searching State");
         
-        // Load saved credentials
-        if (!manager->loadCredentials(ssid, password)) {
+        // Load the stored SSIDs; passwords are read per attempt
+        while (networkCount < WIFI_NETWORKS &&
+               manager->loadCredentials(networkCount, ssids[networkCount], sizeof(ssids[0]), nullptr, 0)) {
+            networkCount++;
+        }
+        if (networkCount == 0) {
             DEBUG_PRINTLN("[SEARCHING] ✗ No saved credentials, entering provisioning");
             manager->transitionTo(createProvisioningState(manager));
             return;
         }
         
-        DEBUG_PRINTF("[SEARCHING] Found credentials for '%s'\n", ssid.c_str());
+        DEBUG_PRINTF("[SEARCHING] Found credentials for %u network(s), '%s' first\n", networkCount, ssids[0]);
+        
+        // A scan from the last visit is reused while fresh
+        if (scan.isFresh(millis())) scan.rewind();
+        else scan.clear();
         
-        // Begin Wi-Fi connection
+        // Begin Wi-Fi connection, skipping the scan if the last link is cached
         WiFi.mode(WIFI_STA);
-        WiFi.begin(ssid.c_str(), password.c_str());
+        fastPath = beginFastPath();
+        manager->markBoot(BOOT_WIFI_START);
+        
+        // A restored scene keeps showing while we connect; otherwise pulse blue
+        LightingEngine* lighting = manager->getLighting();
+        pulsing = !lighting->hasScene();
+        lighting->setActive(!pulsing);
         
-        // Initialize pulse animation
         pulseValue = BRIGHTNESS_MIN;
         pulseDirection = true;
-        lastPulseUpdate = millis();
-        lastConnectionAttempt = millis();
+        
+        Scheduler* scheduler = manager->getScheduler();
+        if (pulsing) {
+            scheduler->every(PULSE_SPEED, [](void* self) {
+                static_cast<SearchingState*>(self)->updatePulseAnimation();
+            }, this);
+        }
+        scheduler->every(WIFI_POLL_INTERVAL, [](void* self) {
+            static_cast<SearchingState*>(self)->attemptConnection();
+        }, this, WIFI_POLL_INTERVAL);
+        timeoutTask = scheduler->after(WIFI_TIMEOUT, [](void* self) {
+            static_cast<SearchingState*>(self)->handleTimeout();
+        }, this);
+        if (fastPath) {
+            scheduler->after(FAST_RECONNECT_TIMEOUT, [](void* self) {
+                static_cast<SearchingState*>(self)->fallBackToScan();
+            }, this);
+        } else {
+            tryNextCandidate();
+        }
     }
     
     void onExit() override {
         DEBUG_PRINTLN("[SEARCHING] Exiting Searching State");
-        // Turn off LEDs
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        leds->clear();
-        leds->show();
-    }
-    
-    void update() override {
-        updatePulseAnimation();
-        attemptConnection();
+        if (scan.getStatus() == NetworkScan::RUNNING) scan.clear(); // Its results would go unread
         
-        // Check for timeout
-        if (hasTimedOut(WIFI_TIMEOUT)) {
-            handleTimeout();
-        }
+        if (!pulsing) return; // Leave the scene up
         
-        // Memory safety check
-        if (manager->getFreeHeap() < MIN_FREE_HEAP) {
-            DEBUG_PRINTF("[SEARCHING] ⚠ Low memory: %d bytes\n", manager->getFreeHeap());
-        }
+        // Turn off LEDs
+        FrameBuffer* frame = manager->getFrameBuffer();
+        frame->clear();
+        frame->show();
     }
     
     void handleTimeout() override {
@@ -126,49 +305,19 @@ public:
         manager->transitionTo(createProvisioningState(manager));
     }
     
+    // In searching state, only respond to the provision and reset commands
     void handleCommand(uint8_t cmd, uint8_t* data, size_t len) override {
-        // In searching state, only respond to the provision command
-        if (cmd == CMD_PROVISION && len >= 2) {
-            DEBUG_PRINTLN("[SEARCHING] Received provision command");
-            
-            // Extract SSID and password from data
-            uint8_t ssidLen = data[0];
-            if (ssidLen > 32 || len < ssidLen + 2) return; // Invalid
-            
-            String newSSID = "";
-            for (int i = 0; i < ssidLen; i++) {
-                newSSID += static_cast<char>(data[1 + i]);
-            }
-            
-            uint8_t passLen = data[1 + ssidLen];
-            if (passLen > 64 || len < ssidLen + passLen + 2) return; // Invalid
-            
-            String newPassword = "";
-            for (int i = 0; i < passLen; i++) {
-                newPassword += static_cast<char>(data[2 + ssidLen + i]);
-            }
-            
-            // Save and reconnect
-            if (manager->saveCredentials(newSSID, newPassword)) {
-                DEBUG_PRINTLN("[SEARCHING] New credentials saved, rebooting...");
-                delay(1000);
-                manager->reboot();
-            }
-        }
-        else if (cmd == CMD_RESET) {
-            DEBUG_PRINTLN("[SEARCHING] Factory reset requested");
-            manager->clearCredentials();
-            manager->reboot();
-        }
+        CommandTable::dispatch(this, COMMANDS, cmd, data, len);
     }
     
     [[nodiscard]] const char* getName() const override { return "Searching"; }
     [[nodiscard]] uint8_t getStateCode() const override { return STATE_SEARCHING; }
 };
 
-// Factory function
+// Factory function: one statically allocated instance, reused on every entry
 inline LuminaState* createSearchingState(StateManager* manager) {
-    return new SearchingState(manager);
+    static SearchingState instance(manager);
+    return &instance;
 }
 
 #endif // SEARCHING_STATE_H
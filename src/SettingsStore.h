@@ -0,0 +1,299 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <Arduino.h>
+#include <flash_hal.h>
+#include "Config.h"
+#include "Crc32.h"
+#include "LinkCache.h"
+#include "Scene.h"
+
+/**
+** ============================================================================
+** SETTINGS - Everything that survives a reboot
+** ============================================================================
+**
+** Add new fields at the end and bump SETTINGS_VERSION: records written by
+** older firmware are shorter and load over the defaults, so new fields keep
+** their default values until the next write.
+**/
+struct WifiNetwork {
+    char ssid[33];                        // NUL-terminated; empty = unused
+    char password[65];
+
+    // CMD_PROVISION payload: [ssidLen, ssid..., passLen, password...]
+    bool parse(const uint8_t* data, size_t len) {
+        if (len < 2) return false;
+
+        size_t ssidLen = data[0];
+        if (ssidLen == 0 || ssidLen >= sizeof(ssid) || len < ssidLen + 2) return false;
+
+        size_t passLen = data[1 + ssidLen];
+        if (passLen >= sizeof(password) || len < ssidLen + passLen + 2) return false;
+
+        memcpy(ssid, &data[1], ssidLen);
+        ssid[ssidLen] = '\0';
+        memcpy(password, &data[2 + ssidLen], passLen);
+        password[passLen] = '\0';
+        return true;
+    }
+};
+
+struct Settings {
+    WifiNetwork network;                  // Most recently connected (or provisioned)
+    uint8_t hasCredentials;
+    uint8_t hasLink;
+    LinkCache link;                       // Fast-reconnect hint (see LinkCache.h)
+
+    // Version 2: restored at power-on before Wi-Fi starts
+    uint8_t hasScene;
+    uint8_t brightness;
+    Scene scene;
+
+    // Version 3
+    uint16_t powerBudget;                 // LED current budget (mA), 0 = default
+
+    // Version 4: further networks, continuing the most-recently-used order
+    WifiNetwork moreNetworks[WIFI_NETWORKS - 1];
+
+    // Version 5
+    uint32_t groups;                      // CMD_GROUP membership, bit n-1 = group n
+
+    // Version 6
+    uint8_t hasLayout;
+    uint16_t stripLengths[LED_STRIPS];    // CMD_SET_STRIPS; defaults until hasLayout
+
+    void setDefaults() {
+        memset(this, 0, sizeof(Settings)); // Also clears padding for memcmp()
+    }
+
+    [[nodiscard]] WifiNetwork& networkAt(uint8_t index) {
+        return index == 0 ? network : moreNetworks[index - 1];
+    }
+
+    [[nodiscard]] const WifiNetwork& networkAt(uint8_t index) const {
+        return index == 0 ? network : moreNetworks[index - 1];
+    }
+};
+
+/**
+** ============================================================================
+** SETTINGS STORE - Append-only, CRC-checked records in a ring of flash
+** ============================================================================
+**
+** The EEPROM library keeps one 4 KB sector and erases it on every commit(),
+** stalling the loop for tens of ms and wearing out that one sector. Instead,
+** each write appends a whole Settings record into the next fixed-size slot
+** of a ring spread over SETTINGS_SECTORS sectors. A sector is only erased
+** when the ring wraps into it, so erases drop by the number of slots per
+** sector and wear is spread over every sector in the ring.
+**
+** Slot layout: [RecordHeader][Settings payload][0xFF padding]
+**
+** At boot every slot is scanned and the valid record (magic, version, CRC32)
+** with the highest sequence number wins. A write torn by a power loss fails
+** its CRC, so the previous record stays in effect.
+**
+** The ring occupies the last SETTINGS_SECTORS sectors of the filesystem
+** region, which this firmware does not mount; a filesystem image uploaded
+** to the device would overwrite the settings.
+**
+** Firmware before settings version 4 used 256-byte slots. Every old slot
+** starts either on a current slot or halfway into one, so begin() checks
+** both positions and an old record is still found until a newer one lands.
+**/
+class SettingsStore {
+private:
+    struct RecordHeader {
+        uint16_t magic;
+        uint8_t version;
+        uint8_t reserved;
+        uint32_t sequence;
+        uint16_t length;                  // Payload bytes
+        uint16_t reserved2;
+        uint32_t crc;                     // Over the header up to here + payload
+    };
+
+    static constexpr uint16_t RECORD_MAGIC = 0x4C53; // "SL"
+    static constexpr size_t SLOTS_PER_SECTOR = SPI_FLASH_SEC_SIZE / SETTINGS_SLOT_SIZE;
+    static constexpr size_t TOTAL_SLOTS = SLOTS_PER_SECTOR * SETTINGS_SECTORS;
+
+    static_assert(sizeof(RecordHeader) == 16, "RecordHeader must not contain padding");
+    static_assert(sizeof(RecordHeader) + sizeof(Settings) <= SETTINGS_SLOT_SIZE,
+                  "Settings no longer fit a slot; raise SETTINGS_SLOT_SIZE");
+    static_assert(SETTINGS_SLOT_SIZE % 4 == 0, "Flash access is word-aligned");
+    static_assert(SETTINGS_SECTORS >= 2, "Erasing the only sector would lose the newest record");
+
+    Settings current;
+    Settings written;                     // Copy of the newest record on flash
+    uint32_t sequence;                    // Of the newest record on flash
+    size_t newestSlot;
+    bool hasRecord;
+    uint32_t writes;
+
+    // Word buffer for one slot; flash reads and writes must be 4-byte aligned
+    union SlotBuffer {
+        uint32_t words[SETTINGS_SLOT_SIZE / 4];
+        uint8_t bytes[SETTINGS_SLOT_SIZE];
+        RecordHeader header;
+    };
+
+    static uint32_t firstSector() {
+        return (FS_PHYS_ADDR + FS_PHYS_SIZE) / SPI_FLASH_SEC_SIZE - SETTINGS_SECTORS;
+    }
+
+    static uint32_t slotAddress(size_t slot) {
+        return (firstSector() + slot / SLOTS_PER_SECTOR) * SPI_FLASH_SEC_SIZE +
+               (slot % SLOTS_PER_SECTOR) * SETTINGS_SLOT_SIZE;
+    }
+
+    static uint32_t recordCrc(const SlotBuffer& buffer) {
+        uint32_t state = Crc32::update(Crc32::INITIAL, buffer.bytes, offsetof(RecordHeader, crc));
+        state = Crc32::update(state, buffer.bytes + sizeof(RecordHeader), buffer.header.length);
+        return Crc32::finish(state);
+    }
+
+    static bool readSlot(size_t slot, SlotBuffer& buffer) {
+        return ESP.flashRead(slotAddress(slot), buffer.words, sizeof(buffer.words));
+    }
+
+    // The second half of a slot, where every other 256-byte slot started
+    static bool readLegacySlot(size_t slot, SlotBuffer& buffer) {
+        return ESP.flashRead(slotAddress(slot) + SETTINGS_LEGACY_SLOT_SIZE, buffer.words, SETTINGS_LEGACY_SLOT_SIZE);
+    }
+
+    static bool isValid(const SlotBuffer& buffer, size_t slotSize = SETTINGS_SLOT_SIZE) {
+        const RecordHeader& header = buffer.header;
+        return header.magic == RECORD_MAGIC &&
+               header.version >= 1 && header.version <= SETTINGS_VERSION &&
+               header.length <= slotSize - sizeof(RecordHeader) &&
+               header.crc == recordCrc(buffer);
+    }
+
+    // Take the record in `buffer` if it is newer than what was found so far
+    void consider(const SlotBuffer& buffer, size_t slot) {
+        if (hasRecord && static_cast<int32_t>(buffer.header.sequence - sequence) <= 0) return;
+
+        // Older, shorter records load over the defaults
+        current.setDefaults();
+        memcpy(&current, buffer.bytes + sizeof(RecordHeader),
+               min(static_cast<size_t>(buffer.header.length), sizeof(Settings)));
+
+        sequence = buffer.header.sequence;
+        newestSlot = slot;
+        hasRecord = true;
+    }
+
+    static bool isBlank(const SlotBuffer& buffer) {
+        for (uint32_t word : buffer.words) {
+            if (word != 0xFFFFFFFF) return false;
+        }
+        return true;
+    }
+
+    /**
+     * The next slot after the newest record that can be programmed: the
+     * first slot of a sector (erased here) or a slot that is still blank.
+     * Slots holding a torn write are skipped.
+     */
+    bool prepareNextSlot(size_t& slot) {
+        SlotBuffer buffer;
+        size_t candidate = hasRecord ? newestSlot : TOTAL_SLOTS - 1;
+
+        for (size_t attempt = 0; attempt < TOTAL_SLOTS; attempt++) {
+            candidate = (candidate + 1) % TOTAL_SLOTS;
+
+            if (candidate % SLOTS_PER_SECTOR == 0) {
+                if (!ESP.flashEraseSector(firstSector() + candidate / SLOTS_PER_SECTOR)) return false;
+                slot = candidate;
+                return true;
+            }
+            if (readSlot(candidate, buffer) && isBlank(buffer)) {
+                slot = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    SettingsStore()
+        : sequence(0),
+          newestSlot(0),
+          hasRecord(false),
+          writes(0) {
+        current.setDefaults();
+        written.setDefaults();
+    }
+
+    /**
+     * Scan the ring and load the newest valid record. Returns false (and
+     * leaves the defaults in place) if the ring holds no valid record.
+     */
+    bool begin() {
+        SlotBuffer buffer;
+        hasRecord = false;
+
+        for (size_t slot = 0; slot < TOTAL_SLOTS; slot++) {
+            if (readSlot(slot, buffer) && isValid(buffer)) consider(buffer, slot);
+            if (readLegacySlot(slot, buffer) && isValid(buffer, SETTINGS_LEGACY_SLOT_SIZE)) consider(buffer, slot);
+        }
+
+        written = current;
+        if (hasRecord) {
+            DEBUG_PRINTF("[SETTINGS] ✓ Loaded record #%u from slot %u\n", sequence, newestSlot);
+        } else {
+            DEBUG_PRINTLN("[SETTINGS] No stored settings, using defaults");
+        }
+        return hasRecord;
+    }
+
+    // Mutable view; call commit() (or let the owner debounce it) afterwards
+    [[nodiscard]] Settings& data() { return current; }
+    [[nodiscard]] const Settings& data() const { return current; }
+
+    [[nodiscard]] bool isDirty() const {
+        return memcmp(&current, &written, sizeof(Settings)) != 0;
+    }
+
+    // Append the current settings as a new record; no-op if nothing changed
+    bool commit() {
+        if (!isDirty()) return true;
+
+        size_t slot;
+        if (!prepareNextSlot(slot)) {
+            DEBUG_PRINTLN("[SETTINGS] ✗ No writable slot");
+            return false;
+        }
+
+        SlotBuffer buffer;
+        memset(buffer.bytes, 0xFF, sizeof(buffer.bytes));
+        buffer.header.magic = RECORD_MAGIC;
+        buffer.header.version = SETTINGS_VERSION;
+        buffer.header.reserved = 0xFF;
+        buffer.header.sequence = sequence + 1;
+        buffer.header.length = sizeof(Settings);
+        buffer.header.reserved2 = 0xFFFF;
+        memcpy(buffer.bytes + sizeof(RecordHeader), &current, sizeof(Settings));
+        buffer.header.crc = recordCrc(buffer);
+
+        if (!ESP.flashWrite(slotAddress(slot), buffer.words, sizeof(buffer.words))) {
+            DEBUG_PRINTLN("[SETTINGS] ✗ Flash write failed");
+            return false;
+        }
+
+        sequence++;
+        newestSlot = slot;
+        hasRecord = true;
+        written = current;
+        writes++;
+
+        DEBUG_PRINTF("[SETTINGS] ✓ Record #%u written to slot %u\n", sequence, slot);
+        return true;
+    }
+
+    [[nodiscard]] uint32_t getSequence() const { return sequence; }
+    [[nodiscard]] uint32_t getWrites() const { return writes; }
+};
+
+#endif // SETTINGS_STORE_H
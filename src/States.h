@@ -1,10 +1,26 @@
 #ifndef STATES_H
 #define STATES_H
 
-#include <Adafruit_NeoPixel.h>
+#include <IPAddress.h>
 
-// Forward declaration to avoid circular dependency
+// Forward declarations to avoid circular dependency
 class StateManager;
+class EffectSequence;
+class FrameBuffer;
+class LightingEngine;
+class NetworkClock;
+class Profiler;
+class Scheduler;
+class ScriptProgram;
+class SubscriberTable;
+class WiFiUDP;
+enum BootMark : uint8_t;
+struct IntakeStats;
+struct LinkCache;
+struct MulticastOffer;
+struct OtaRequest;
+struct ScriptAnalysis;
+struct Scene;
 
 // ============================================================================
 // ABSTRACT STATE BASE CLASS
@@ -16,10 +32,21 @@ public:
     // State lifecycle methods
     virtual void onEnter() = 0;           // Called when entering this state
     virtual void onExit() = 0;            // Called when leaving this state
-    virtual void update() = 0;            // Called every loop iteration
+    virtual void update() {}              // Called every loop iteration; prefer
+                                          // scheduler tasks for periodic work
+    
+    // States are singletons (see the factory functions) that are re-entered
+    // rather than re-created. reset() puts a state back the way its
+    // constructor left it; transitionTo() calls it just before onEnter().
+    virtual void reset() { stateStartTime = 0; }
     
     // Event handlers
     virtual void handleCommand(uint8_t cmd, uint8_t* data, size_t len) = 0;
+    
+    // Optional: consume a waiting datagram straight from the socket (e.g. into
+    // the frame buffer) instead of having it copied for handleCommand().
+    // Return true if the datagram was taken.
+    virtual bool receiveDirect(WiFiUDP&, int) { return false; }
     virtual void handleTimeout() {}       // Optional timeout handling
     
     // State identification
@@ -49,24 +76,57 @@ public:
     virtual void transitionTo(LuminaState* newState) = 0;
     [[nodiscard]] virtual LuminaState* getCurrentState() const = 0;
     
+    // Cooperative scheduler; tasks registered with the state as context are
+    // cancelled automatically when the state is left
+    virtual Scheduler* getScheduler() = 0;
+    
     // Hardware access (safely shared across states)
-    virtual Adafruit_NeoPixel* getLEDs() = 0;
+    virtual FrameBuffer* getFrameBuffer() = 0;    // Every strip, one frame (see FrameBuffer.h)
+    virtual LightingEngine* getLighting() = 0;    // Active scene; outlives states
+    virtual EffectSequence* getEffects() = 0;     // Non-blocking flashes and sweeps
+    virtual Profiler* getProfiler() = 0;          // Hot-path timings (CMD_GET_PROFILE)
+    virtual NetworkClock* getClock() = 0;         // Shared animation time (CMD_SYNC_CLOCK)
+    virtual void markBoot(BootMark mark) = 0;     // Boot timeline, first time only (Profiler.h)
     virtual float getBatteryVoltage() = 0;
     virtual uint8_t getBatteryPercent() = 0;
     
     // Network access
-    virtual bool sendUDP(const uint8_t* data, size_t len) = 0;
+    virtual bool sendUDP(const uint8_t* data, size_t len) = 0;     // To subscribers, else broadcast
+    virtual bool sendUDPTo(const IPAddress& ip, uint16_t port, const uint8_t* data, size_t len) = 0;
+    virtual SubscriberTable* getSubscribers() = 0;
+    virtual IntakeStats receiveCommands(WiFiUDP& udp) = 0;         // Drain into handleCommand()
     virtual bool isWiFiConnected() = 0;
     virtual String getLocalIP() = 0;
     
+    // Scene changes: shown on the next frame and persisted (debounced)
+    virtual void applyScene(const Scene& scene, uint16_t fadeMs) = 0;
+    virtual void applyBrightness(uint8_t brightness) = 0;
+    virtual void applyPowerBudget(uint16_t milliamps) = 0;       // 0 = default; derated on low battery
+    virtual void applyGroups(uint32_t mask) = 0;                  // Persisted group membership
+    [[nodiscard]] virtual uint32_t getGroups() const = 0;
+    virtual ScriptAnalysis applyScript(const uint8_t* program, size_t len) = 0; // Check, store and keep in RAM
+    [[nodiscard]] virtual const ScriptProgram* getScript() const = 0;
+    virtual void applyLayout(const uint16_t* lengths) = 0;       // LED_STRIPS strip lengths, persisted
+    
     // Credential management
-    virtual bool saveCredentials(const String& ssid, const String& password) = 0;
-    virtual bool loadCredentials(String& ssid, String& password) = 0;
+    virtual bool saveCredentials(const char* ssid, const char* password) = 0;
+    // Stored networks, most recently used first; password may be nullptr
+    virtual bool loadCredentials(uint8_t index, char* ssid, size_t ssidSize, char* password, size_t passwordSize) = 0;
+    virtual void promoteNetwork(uint8_t index) = 0;               // Connected: try it first next time
     virtual void clearCredentials() = 0;
     
+    // Fast-reconnect hint (BSSID, channel, lease); dropped with the credentials
+    virtual bool saveLinkCache(const LinkCache& cache) = 0;
+    virtual bool loadLinkCache(LinkCache& cache) = 0;
+    
+    // Radio power: low power lets the radio (and, when the loop is idle long
+    // enough, the CPU) sleep between DTIM beacons. Cleared on every transition
+    virtual void setLowPower(bool enabled) = 0;
+    
     // System control
-    virtual void reboot() = 0;
+    virtual void reboot() = 0;                    // Restarts after REBOOT_DELAY; returns at once
     virtual uint32_t getFreeHeap() = 0;
+    virtual uint32_t getMaxFreeBlock() = 0;       // Largest allocation that can succeed
 };
 
 // ============================================================================
@@ -82,6 +142,7 @@ public:
 extern LuminaState* createSearchingState(StateManager* manager);
 extern LuminaState* createProvisioningState(StateManager* manager);
 extern LuminaState* createConnectedState(StateManager* manager);
-extern LuminaState* createUpdatingState(StateManager* manager);
+extern LuminaState* createUpdatingState(StateManager* manager, const OtaRequest* pull = nullptr);
+extern LuminaState* createMulticastUpdatingState(StateManager* manager, const MulticastOffer& offer);
 
 #endif // STATES_H
@@ -0,0 +1,117 @@
+#ifndef SUBSCRIBER_TABLE_H
+#define SUBSCRIBER_TABLE_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** SUBSCRIBER TABLE - Leased unicast destinations for status traffic
+** ============================================================================
+**
+** Controllers register with CMD_SUBSCRIBE and renew before their lease runs
+** out. While at least one lease is live, status is unicast to each
+** subscriber instead of waking every device on the subnet with a broadcast.
+** Broadcast remains the fallback when nobody is subscribed, so the app can
+** still discover new lamps.
+**
+** The table is a fixed array: a new subscriber replaces the one whose lease
+** ends soonest when it is full.
+**/
+class SubscriberTable {
+public:
+    struct Subscriber {
+        IPAddress ip;
+        uint16_t port;
+        unsigned long expiresAt;
+        bool active;
+    };
+
+private:
+    Subscriber entries[MAX_SUBSCRIBERS];
+
+    static bool expired(const Subscriber& entry, unsigned long now) {
+        return static_cast<long>(now - entry.expiresAt) >= 0;
+    }
+
+public:
+    SubscriberTable() : entries{} {}
+
+    // Add or renew a lease. A lease of 0 removes the subscriber.
+    void subscribe(const IPAddress& ip, uint16_t port, uint16_t leaseSeconds) {
+        if (leaseSeconds == 0) {
+            unsubscribe(ip, port);
+            return;
+        }
+
+        if (leaseSeconds > SUBSCRIBER_MAX_LEASE) leaseSeconds = SUBSCRIBER_MAX_LEASE;
+        unsigned long expiresAt = millis() + leaseSeconds * 1000UL;
+
+        Subscriber* slot = nullptr;
+        for (Subscriber& entry : entries) {
+            if (entry.active && entry.ip == ip && entry.port == port) {
+                slot = &entry; // Renewal
+                break;
+            }
+            if (!entry.active && !slot) slot = &entry;
+        }
+
+        // Full: evict the lease that ends soonest
+        if (!slot) {
+            slot = &entries[0];
+            for (Subscriber& entry : entries) {
+                if (static_cast<long>(entry.expiresAt - slot->expiresAt) < 0) slot = &entry;
+            }
+        }
+
+        slot->ip = ip;
+        slot->port = port;
+        slot->expiresAt = expiresAt;
+        slot->active = true;
+
+        DEBUG_PRINTF("[SUBSCRIBERS] %s:%u leased for %us\n",
+                   ip.toString().c_str(), port, leaseSeconds);
+    }
+
+    void unsubscribe(const IPAddress& ip, uint16_t port) {
+        for (Subscriber& entry : entries) {
+            if (entry.active && entry.ip == ip && entry.port == port) {
+                entry.active = false;
+                DEBUG_PRINTF("[SUBSCRIBERS] %s:%u unsubscribed\n", ip.toString().c_str(), port);
+            }
+        }
+    }
+
+    bool contains(const IPAddress& ip, uint16_t port) const {
+        for (const Subscriber& entry : entries) {
+            if (entry.active && entry.ip == ip && entry.port == port) return true;
+        }
+        return false;
+    }
+
+    // Drop lapsed leases; returns the number still live
+    uint8_t expire(unsigned long now) {
+        uint8_t live = 0;
+        for (Subscriber& entry : entries) {
+            if (!entry.active) continue;
+            if (expired(entry, now)) {
+                entry.active = false;
+                DEBUG_PRINTF("[SUBSCRIBERS] %s:%u lease expired\n",
+                           entry.ip.toString().c_str(), entry.port);
+            } else {
+                live++;
+            }
+        }
+        return live;
+    }
+
+    void clear() {
+        for (Subscriber& entry : entries) entry.active = false;
+    }
+
+    [[nodiscard]] const Subscriber* begin() const { return entries; }
+    [[nodiscard]] const Subscriber* end() const { return entries + MAX_SUBSCRIBERS; }
+};
+
+#endif // SUBSCRIBER_TABLE_H
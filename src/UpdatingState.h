@@ -4,6 +4,13 @@
 #include "States.h"
 #include <ArduinoOTA.h>
 #include "Config.h"
+#include "CommandTable.h"
+#include "EffectSequence.h"
+#include "FirmwareDownload.h"
+#include "FrameBuffer.h"
+#include "LightingEngine.h"
+#include "MulticastImage.h"
+#include "Scheduler.h"
 #include "ConnectedState.h"
 #include "SearchingState.h"
 
@@ -12,20 +19,35 @@
 // ============================================================================
 /**
  * Updating State - Handles OTA updates
+ *
+ * Push (CMD_OTA_START without payload): waits for espota / ArduinoOTA.
+ * Pull (CMD_OTA_START with a URL): downloads the image itself, see
+ * FirmwareDownload.h.
+ * Multicast (CMD_OTA_MULTICAST): receives the image with the rest of the
+ * fleet, see MulticastImage.h.
  */
 class UpdatingState : public LuminaState {
 private:
-    unsigned long lastPulse;
     uint8_t yellowBrightness;
     bool pulseDirection;
     bool otaConfigured;
     uint8_t lastProgress;
-    LuminaState* previousState; // For rollback on failure
+    Scheduler::TaskId pulseTask;
+    Scheduler::TaskId timeoutTask;
+    
+    enum Source : uint8_t { SOURCE_PUSH, SOURCE_PULL, SOURCE_MULTICAST };
+    
+    // Where the image comes from; set by the factories, so reset() leaves
+    // these alone
+    Source source;
+    OtaRequest pullRequest;
+    MulticastOffer multicastOffer;
+    
+    FirmwareDownload download;
+    MulticastImage multicast;
+    Scheduler::TaskId downloadTask;
     
     void updateYellowPulse() {
-        if (millis() - lastPulse < 30) return; // Fast pulse during update
-        lastPulse = millis();
-        
         if (pulseDirection) {
             yellowBrightness += 10;
             if (yellowBrightness >= 200) {
@@ -40,56 +62,60 @@ private:
             }
         }
         
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        for (int i = 0; i < LED_COUNT; i++) {
-            leds->setPixelColor(i, yellowBrightness, yellowBrightness, 0);
-        }
-        leds->show();
+        FrameBuffer* frame = manager->getFrameBuffer();
+        frame->fill(Color(yellowBrightness, yellowBrightness, 0));
+        frame->show();
     }
     
     void showProgress(uint8_t percent) {
         if (percent == lastProgress) return;
         lastProgress = percent;
         
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        leds->clear();
+        FrameBuffer* frame = manager->getFrameBuffer();
+        frame->clear();
         
         // Fill LEDs proportionally to progress
-        int ledsToLight = (percent * LED_COUNT) / 100;
+        int ledsToLight = (percent * frame->length()) / 100;
         for (int i = 0; i < ledsToLight; i++) {
-            leds->setPixelColor(i, Colors::UPDATING.to32bit());
+            frame->setPixel(i, Colors::UPDATING);
         }
-        leds->show();
+        frame->show();
         
         DEBUG_PRINTF("[UPDATE] Progress: %d%%\n", percent);
     }
     
+    static const char* otaErrorName(ota_error_t error) {
+        switch (error) {
+            case OTA_AUTH_ERROR: return "Auth Failed";
+            case OTA_BEGIN_ERROR: return "Begin Failed";
+            case OTA_CONNECT_ERROR: return "Connect Failed";
+            case OTA_RECEIVE_ERROR: return "Receive Failed";
+            case OTA_END_ERROR: return "End Failed";
+            default: return "Unknown";
+        }
+    }
+    
     void setupOTA() {
         if (otaConfigured) return;
         
         ArduinoOTA.setHostname(DEVICE_NAME);
         ArduinoOTA.setPassword("lumina-ota-2026"); // OTA password
+        ArduinoOTA.setRebootOnSuccess(false);      // Reboot after the success sweep instead
         
         ArduinoOTA.onStart([this]() {
             String type = (ArduinoOTA.getCommand() == U_FLASH) ? "sketch" : "filesystem";
             DEBUG_PRINTF("[UPDATE] Starting OTA: %s\n", type.c_str());
             
             // Turn off LEDs during flash
-            Adafruit_NeoPixel* leds = manager->getLEDs();
-            leds->clear();
-            leds->show();
+            FrameBuffer* frame = manager->getFrameBuffer();
+            frame->clear();
+            frame->show();
         });
         
         ArduinoOTA.onEnd([this]() {
             DEBUG_PRINTLN("\n[UPDATE] ✓ OTA Complete!");
             
-            // Success animation - green sweep
-            Adafruit_NeoPixel* leds = manager->getLEDs();
-            for (int i = 0; i < LED_COUNT; i++) {
-                leds->setPixelColor(i, Colors::CONNECTED.to32bit());
-                leds->show();
-                delay(50);
-            }
+            finishUpdate();
         });
         
         ArduinoOTA.onProgress([this](unsigned int progress, unsigned int total) {
@@ -97,58 +123,145 @@ private:
             showProgress(percent);
         });
         
-        ArduinoOTA.onError([this](ota_error_t error) {
-            DEBUG_PRINTF("\n[UPDATE] ✗ Error[%u]: ", error);
-            
-            const char* errorMsg = "Unknown";
-            switch (error) {
-                case OTA_AUTH_ERROR: errorMsg = "Auth Failed"; break;
-                case OTA_BEGIN_ERROR: errorMsg = "Begin Failed"; break;
-                case OTA_CONNECT_ERROR: errorMsg = "Connect Failed"; break;
-                case OTA_RECEIVE_ERROR: errorMsg = "Receive Failed"; break;
-                case OTA_END_ERROR: errorMsg = "End Failed"; break;
-            }
-            DEBUG_PRINTLN(errorMsg);
-            
-            // Error animation - red flash
-            Adafruit_NeoPixel* leds = manager->getLEDs();
-            for (int i = 0; i < 3; i++) {
-                for (int j = 0; j < LED_COUNT; j++) {
-                    leds->setPixelColor(j, Colors::ERROR_COLOR.to32bit());
-                }
-                leds->show();
-                delay(200);
-                leds->clear();
-                leds->show();
-                delay(200);
-            }
-            
-            // Rollback to the previous state
-            DEBUG_PRINTLN("[UPDATE] Rolling back to previous state...");
-            delay(1000);
-            
-            manager->transitionTo(createConnectedState(manager));
+        ArduinoOTA.onError([this]([[maybe_unused]] ota_error_t error) {
+            DEBUG_PRINTF("\n[UPDATE] ✗ Error[%u]: %s\n", error, otaErrorName(error));
+            failUpdate();
         });
         
         ArduinoOTA.begin();
         otaConfigured = true;
         DEBUG_PRINTLN("[UPDATE] OTA configured and ready");
     }
+    
+    void beginDownload() {
+        if (source == SOURCE_PULL) {
+            download.begin(pullRequest);
+        } else {
+            multicast.begin(multicastOffer);
+        }
+        downloadTask = manager->getScheduler()->every(OTA_POLL_INTERVAL, [](void* self) {
+            static_cast<UpdatingState*>(self)->pumpDownload();
+        }, this);
+    }
+    
+    void pumpDownload() {
+        bool running, complete, progressed;
+        uint8_t percent;
+        
+        if (source == SOURCE_PULL) {
+            uint32_t before = download.getReceived();
+            FirmwareDownload::Status status = download.poll();
+            running = status == FirmwareDownload::RUNNING;
+            complete = status == FirmwareDownload::COMPLETE;
+            progressed = download.getReceived() != before;
+            percent = download.getPercent();
+        } else {
+            uint16_t before = multicast.getChunksReceived();
+            MulticastImage::Status status = multicast.poll();
+            running = status == MulticastImage::RECEIVING || status == MulticastImage::VERIFYING;
+            complete = status == MulticastImage::COMPLETE;
+            progressed = multicast.getChunksReceived() != before;
+            percent = multicast.getPercent();
+        }
+        
+        if (progressed) {
+            Scheduler* scheduler = manager->getScheduler();
+            scheduler->postpone(timeoutTask, OTA_IDLE_TIMEOUT);
+            if (pulseTask != Scheduler::INVALID_TASK) {
+                scheduler->cancel(pulseTask); // The progress bar takes over
+                pulseTask = Scheduler::INVALID_TASK;
+            }
+            showProgress(percent);
+        }
+        
+        if (running) return;
+        manager->getScheduler()->cancel(downloadTask);
+        if (complete) {
+            finishUpdate();
+        } else {
+            DEBUG_PRINTF("[UPDATE] ✗ Download failed: %s\n",
+                       source == SOURCE_PULL ? download.getError() : multicast.getError());
+            failUpdate();
+        }
+    }
+    
+    // Success animation - green sweep, then reboot into the new image
+    void finishUpdate() {
+        manager->getScheduler()->cancel(pulseTask);
+        manager->getFrameBuffer()->clear();
+        manager->getEffects()->play(Effects::SUCCESS_SWEEP, this, [](void* self) {
+            static_cast<UpdatingState*>(self)->manager->reboot();
+        });
+    }
+    
+    // Error animation - red flash, a dark pause, then roll back
+    void failUpdate() {
+        manager->getScheduler()->cancel(pulseTask);
+        manager->getEffects()->play(Effects::ERROR_FLASH, this, [](void* self) {
+            static_cast<UpdatingState*>(self)->pauseBeforeRollback();
+        });
+    }
+    
+    void pauseBeforeRollback() {
+        DEBUG_PRINTLN("[UPDATE] Rolling back to previous state...");
+        manager->getEffects()->play(Effects::ERROR_PAUSE, this, [](void* self) {
+            UpdatingState* state = static_cast<UpdatingState*>(self);
+            state->manager->transitionTo(createConnectedState(state->manager));
+        });
+    }
+    
+    void onGetStatus(CommandView) {
+        DEBUG_PRINTLN("[UPDATE] Status requested during update");
+        // Send update-in-progress status
+        uint8_t response[3] = {STATUS_STATE, STATE_UPDATING, lastProgress};
+        manager->sendUDP(response, 3);
+    }
+    
+    static constexpr CommandHandler<UpdatingState> COMMANDS[] = {
+        {CMD_GET_STATUS, 0, &UpdatingState::onGetStatus},
+    };
 
 public:
     explicit UpdatingState(StateManager* mgr) 
         : LuminaState(mgr),
-          lastPulse(0),
           yellowBrightness(20),
           pulseDirection(true),
           otaConfigured(false),
           lastProgress(0),
-          previousState(nullptr) {}
+          pulseTask(Scheduler::INVALID_TASK),
+          timeoutTask(Scheduler::INVALID_TASK),
+          source(SOURCE_PUSH),
+          pullRequest{},
+          multicastOffer{},
+          downloadTask(Scheduler::INVALID_TASK) {}
+    
+    void reset() override {
+        LuminaState::reset();
+        yellowBrightness = 20;
+        pulseDirection = true;
+        lastProgress = 0;
+        pulseTask = Scheduler::INVALID_TASK;
+        timeoutTask = Scheduler::INVALID_TASK;
+        downloadTask = Scheduler::INVALID_TASK;
+        // otaConfigured is cleared by onExit() together with ArduinoOTA.end()
+    }
+    
+    // Called by the factories before each entry; nullptr means push mode
+    void requestPull(const OtaRequest* request) {
+        source = request ? SOURCE_PULL : SOURCE_PUSH;
+        if (request) pullRequest = *request;
+    }
+    
+    void requestMulticast(const MulticastOffer& offer) {
+        source = SOURCE_MULTICAST;
+        multicastOffer = offer;
+    }
     
     void onEnter() override {
         stateStartTime = millis();
         DEBUG_PRINTLN("\n[UPDATE] Entering Updating State");
         DEBUG_PRINTLN("[UPDATE] ⚠ Device locked during update");
+        manager->getLighting()->setActive(false);
         
         // Check if Wi-Fi is connected
         if (WiFi.status() != WL_CONNECTED) {
@@ -157,56 +270,72 @@ public:
             return;
         }
         
-        setupOTA();
-        
-        lastPulse = millis();
         yellowBrightness = 20;
         pulseDirection = true;
         lastProgress = 0;
+        
+        Scheduler* scheduler = manager->getScheduler();
+        if (source != SOURCE_PUSH) {
+            beginDownload();
+        } else {
+            setupOTA();
+            scheduler->every(UDP_POLL_INTERVAL, [](void*) {
+                ArduinoOTA.handle();
+            }, this);
+        }
+        pulseTask = scheduler->every(30, [](void* self) { // Fast pulse during update
+            static_cast<UpdatingState*>(self)->updateYellowPulse();
+        }, this);
+        
+        // Timeout after 10 minutes of no activity
+        timeoutTask = scheduler->after(OTA_IDLE_TIMEOUT, [](void* self) {
+            static_cast<UpdatingState*>(self)->handleTimeout();
+        }, this);
     }
     
     void onExit() override {
         DEBUG_PRINTLN("[UPDATE] Exiting Updating State");
-        ArduinoOTA.end();
+        download.cancel();                // Discards a partial image
+        multicast.cancel();
+        if (otaConfigured) ArduinoOTA.end();
         otaConfigured = false;
         
-        Adafruit_NeoPixel* leds = manager->getLEDs();
-        leds->clear();
-        leds->show();
+        FrameBuffer* frame = manager->getFrameBuffer();
+        frame->clear();
+        frame->show();
     }
     
-    void update() override {
-        // Handle OTA
-        ArduinoOTA.handle();
-        
-        // Update visual feedback
-        updateYellowPulse();
-        
-        // Timeout after 10 minutes of no activity
-        if (hasTimedOut(600000)) {
-            DEBUG_PRINTLN("[UPDATE] Update timeout, returning to connected");
-            manager->transitionTo(createConnectedState(manager));
-        }
+    void handleTimeout() override {
+        DEBUG_PRINTLN("[UPDATE] Update timeout, returning to connected");
+        manager->transitionTo(createConnectedState(manager));
     }
     
+    // During update, only respond to status requests; all other commands
+    // are ignored for safety
     void handleCommand(uint8_t cmd, uint8_t* data, size_t len) override {
-        // During update, only respond to status requests
-        if (cmd == CMD_GET_STATUS) {
-            DEBUG_PRINTLN("[UPDATE] Status requested during update");
-            // Send update-in-progress status
-            uint8_t response[3] = {STATUS_STATE, STATE_UPDATING, lastProgress};
-            manager->sendUDP(response, 3);
-        }
-        // Ignore all other commands during update for safety
+        CommandTable::dispatch(this, COMMANDS, cmd, data, len);
     }
     
     const char* getName() const override { return "Updating"; }
     uint8_t getStateCode() const override { return STATE_UPDATING; }
 };
 
-// Factory function
-inline LuminaState* createUpdatingState(StateManager* manager) {
-    return new UpdatingState(manager);
+// Factory functions: one statically allocated instance, reused on every entry
+inline UpdatingState* updatingStateInstance(StateManager* manager) {
+    static UpdatingState instance(manager);
+    return &instance;
+}
+
+inline LuminaState* createUpdatingState(StateManager* manager, const OtaRequest* pull) {
+    UpdatingState* state = updatingStateInstance(manager);
+    state->requestPull(pull);
+    return state;
+}
+
+inline LuminaState* createMulticastUpdatingState(StateManager* manager, const MulticastOffer& offer) {
+    UpdatingState* state = updatingStateInstance(manager);
+    state->requestMulticast(offer);
+    return state;
 }
 
 #endif // UPDATING_STATE_H
@@ -0,0 +1,163 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+** ============================================================================
+** WAVEFORM ENGINE - Integer-only animation math
+** ============================================================================
+**
+** The ESP8266 has no FPU, so every sin() and float multiply in a render path
+** ends up in soft-float library code. This engine replaces them with:
+**
+**  - A 256-entry sine table and a 256-entry gamma table, generated at compile
+**    time (constexpr) and placed in flash (PROGMEM).
+**  - 16-bit phase accumulators, so a waveform period is one integer divide
+**    by a compile-time constant.
+**  - 8.8 fixed-point brightness levels (256 == full brightness).
+**
+** A complete frame is computed with integer adds, multiplies and shifts.
+**/
+namespace Waveform {
+
+    // 8.8 fixed-point brightness level: 0 = off, 256 = full brightness
+    typedef uint16_t Level;
+    constexpr Level LEVEL_FULL = 256;
+
+    constexpr uint8_t GAMMA = 25;            // Gamma x10 (2.5) used for the gamma table
+
+    // ========================================================================
+    // COMPILE-TIME TABLE GENERATION
+    // ========================================================================
+    namespace detail {
+        constexpr double TWO_PI = 6.283185307179586;
+
+        // Taylor series sine, accurate to ~1e-12 on [-PI, PI]
+        constexpr double sine(double x) {
+            while (x > TWO_PI / 2) x -= TWO_PI;
+            while (x < -TWO_PI / 2) x += TWO_PI;
+
+            double term = x;
+            double sum = x;
+            for (int n = 1; n < 12; n++) {
+                term *= -x * x / ((2 * n) * (2 * n + 1));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // Newton-Raphson square root
+        constexpr double squareRoot(double x) {
+            if (x <= 0) return 0;
+            double guess = x > 1 ? x : 1;
+            for (int i = 0; i < 32; i++) {
+                guess = (guess + x / guess) / 2;
+            }
+            return guess;
+        }
+
+        // x^2.5 == x^2 * sqrt(x) on the unit interval
+        constexpr double gammaCurve(double x) {
+            return x * x * squareRoot(x);
+        }
+
+        constexpr uint8_t roundToByte(double x) {
+            return static_cast<uint8_t>(x * 255.0 + 0.5);
+        }
+
+        struct Table {
+            uint8_t values[256];
+        };
+
+        // (sin(2*PI*i/256) + 1) / 2, scaled to 0..255
+        constexpr Table makeSineTable() {
+            Table table{};
+            for (int i = 0; i < 256; i++) {
+                table.values[i] = roundToByte((sine(TWO_PI * i / 256.0) + 1.0) / 2.0);
+            }
+            return table;
+        }
+
+        // Perceptual correction for WS2812B output
+        constexpr Table makeGammaTable() {
+            Table table{};
+            for (int i = 0; i < 256; i++) {
+                table.values[i] = roundToByte(gammaCurve(i / 255.0));
+            }
+            return table;
+        }
+
+        static_assert(GAMMA == 25, "gammaCurve() implements a 2.5 curve");
+    }
+
+    static constexpr detail::Table SINE_TABLE PROGMEM = detail::makeSineTable();
+    static constexpr detail::Table GAMMA_TABLE PROGMEM = detail::makeGammaTable();
+
+    static_assert(SINE_TABLE.values[0] == 128 && SINE_TABLE.values[64] == 255 &&
+                  SINE_TABLE.values[192] == 0, "Sine table generation is broken");
+    static_assert(GAMMA_TABLE.values[0] == 0 && GAMMA_TABLE.values[255] == 255,
+                  "Gamma table generation is broken");
+
+    // ========================================================================
+    // PHASE AND WAVEFORMS
+    // ========================================================================
+
+    /**
+     * Position inside a repeating period as a 16-bit phase (0..65535).
+     * The period is a template argument so the divide becomes a multiply.
+     */
+    template <uint32_t PERIOD_MS>
+    inline uint16_t phase(unsigned long time) {
+        static_assert(PERIOD_MS > 0 && PERIOD_MS <= 65536, "Period out of range");
+        return static_cast<uint16_t>((static_cast<uint32_t>(time % PERIOD_MS) << 16) / PERIOD_MS);
+    }
+
+    /**
+     * Sine wave remapped to 0..255, linearly interpolated between table entries.
+     * phase 0 = midpoint rising, 16384 = peak, 49152 = trough.
+     */
+    inline uint8_t sine8(uint16_t phase) {
+        uint8_t index = phase >> 8;
+        uint8_t fraction = phase & 0xFF;
+
+        int16_t a = pgm_read_byte(&SINE_TABLE.values[index]);
+        int16_t b = pgm_read_byte(&SINE_TABLE.values[static_cast<uint8_t>(index + 1)]);
+
+        return static_cast<uint8_t>(a + (((b - a) * fraction) >> 8));
+    }
+
+    inline uint8_t gamma8(uint8_t value) {
+        return pgm_read_byte(&GAMMA_TABLE.values[value]);
+    }
+
+    // ========================================================================
+    // FIXED-POINT BRIGHTNESS
+    // ========================================================================
+
+    // Widen an 8-bit intensity to a level so that 255 maps to LEVEL_FULL
+    constexpr Level fromByte(uint8_t value) {
+        return value + (value >> 7);
+    }
+
+    // Map an 8-bit wave sample onto [low, high]
+    inline Level range(uint8_t wave, Level low, Level high) {
+        return low + static_cast<Level>(((high - low) * fromByte(wave)) >> 8);
+    }
+
+    inline uint8_t scale8(uint8_t channel, Level level) {
+        return static_cast<uint8_t>((channel * level) >> 8);
+    }
+
+    inline Color scale(const Color& color, Level level) {
+        return Color(scale8(color.r, level), scale8(color.g, level), scale8(color.b, level));
+    }
+
+    // Blend from a to b: amount 0 gives a, LEVEL_FULL gives b exactly
+    inline uint8_t lerp8(uint8_t a, uint8_t b, Level amount) {
+        return static_cast<uint8_t>(a + (((b - a) * static_cast<int16_t>(amount)) >> 8));
+    }
+}
+
+#endif // WAVEFORM_H
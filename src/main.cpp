@@ -32,7 +32,6 @@
  */
 
 #include <ESP8266WiFi.h>
-#include <Adafruit_NeoPixel.h>
 
 // Include all our custom headers
 #include "Config.h"
@@ -49,45 +48,27 @@ LuminaStateManager stateManager;
 // ARDUINO SETUP
 // ============================================================================
 void setup() {
-    // Initialize Serial for debugging
+    // Initialize Serial for debugging. No settle delay: the banner comes
+    // later, once the lamp is connected
     #if DEBUG_MODE
     Serial.begin(SERIAL_BAUD);
-    delay(100);
-    Serial.println();
     #endif
     
-    // Startup animation - Quick rainbow
-    stateManager.begin(); // This initializes LEDs
-    
-    Adafruit_NeoPixel* leds = stateManager.getLEDs();
-    for (int j = 0; j < 255; j += 15) {
-        for (int i = 0; i < LED_COUNT; i++) {
-            int hue = (i * 65536 / LED_COUNT + j * 256) % 65536;
-            uint32_t color = Adafruit_NeoPixel::ColorHSV(hue);
-            leds->setPixelColor(i, color);
-        }
-        leds->show();
-        delay(20);
-    }
-    leds->clear();
-    leds->show();
-    
-    DEBUG_PRINTLN("✓ Lumina initialized successfully\n");
+    // Restores the saved scene and starts Wi-Fi; the boot animation and
+    // everything else run from the scheduler (see LuminaStateManager::begin())
+    stateManager.begin();
 }
 
 // ============================================================================
 // ARDUINO MAIN LOOP
 // ============================================================================
 void loop() {
-    // Update current state
+    // Run the current state and every scheduler task that is due
     stateManager.update();
     
-    // Small delay to prevent tight loop CPU usage
-    // The ESP8266 needs breathing room for Wi-Fi stack
-    delay(10);
-    
-    // Yield to ESP8266 system tasks
-    yield();
+    // Sleep exactly until the next task deadline; the Wi-Fi stack runs
+    // while we wait
+    stateManager.idle();
 }
 
 // ============================================================================
@@ -96,26 +77,34 @@ void loop() {
 /**
  * MEMORY OPTIMIZATION TIPS:
  * -------------------------
- * 1. The State Pattern ensures only ONE state's code is in RAM at a time
+ * 1. States are static singletons: transitions never allocate
  * 2. Use String sparingly - prefer const char* for fixed strings
- * 3. Always delete old states before creating new ones
- * 4. Monitor getFreeHeap() regularly during development
+ * 3. Keep heap allocations out of states; reset() must restore every member
+ * 4. Monitor getFreeHeap() and getMaxFreeBlock() regularly during development
  * 5. Use F() macro for debug strings: DEBUG_PRINTLN(F("Text"));
  * 
  * ADDING NEW STATES:
  * ------------------
  * 1. Create NewState.h inheriting from LuminaState
  * 2. Implement all pure virtual methods
+ *    (register periodic work with manager->getScheduler() in onEnter();
+ *    it is cancelled automatically on exit). Never delay() in state code:
+ *    play timed flashes with manager->getEffects() (EffectSequence.h)
  * 3. Add factory function: LuminaState* createNewState(StateManager*)
+ *    returning a function-local static instance, and override reset()
  * 4. Include the header in this file
  * 5. Transition to it: manager->transitionTo(createNewState(manager))
  * 
  * ADDING NEW LIGHTING STRATEGIES:
  * --------------------------------
- * 1. Create class inheriting from LightingStrategy in ConnectedState.h
- * 2. Implement apply() method with your animation logic
- * 3. Add new CMD_SET_MOOD case to handle it
- * 4. Update Android app to send the new mood type
+ * 1. Create class inheriting from LightingStrategy in LightingEngine.h
+ * 2. Implement apply() method with your animation logic (draw into the
+ *    FrameBuffer; the manager decides when it is pushed to the strip)
+ *    and configure() to read its parameters from a Scene
+ * 3. Add it to the StrategySlot type list so the slot is large enough
+ * 4. Give it a STRATEGY_* id and a case in LightingEngine::setScene()
+ * 5. Add new CMD_SET_MOOD case to handle it
+ * 6. Update Android app to send the new mood type
  * 
  * PROTOCOL EXTENSIONS:
  * --------------------
@@ -131,10 +120,13 @@ void loop() {
  * 
  * ANDROID APP INTEGRATION:
  * ------------------------
- * 1. App discovers device via UDP broadcast (STATUS_HEARTBEAT)
- * 2. App sends commands to device IP on UDP_PORT (4210)
- * 3. Device responds with status packets
- * 4. Use Kotlin Flows to observe heartbeat packets
+ * 1. App discovers device via STATUS_HEARTBEAT_V2 (0x14), broadcast to the
+ *    subnet while no controller is subscribed
+ * 2. App sends CMD_SUBSCRIBE to lease unicast status; heartbeats then go to
+ *    subscribers only, so renew the lease before it expires
+ * 3. App sends commands to device IP on UDP_PORT (4210)
+ * 4. Use Kotlin Flows to observe heartbeat packets (delta-encoded; request
+ *    a full snapshot with CMD_GET_STATUS, see Heartbeat.h)
  * 5. Parse battery, heap, and RSSI for "Product Health" UI
  * 
  * GEMINI AI INTEGRATION:
@@ -148,7 +140,8 @@ void loop() {
  * POWER OPTIMIZATION:
  * -------------------
  * For extended battery life:
- * 1. Use WiFi.setSleepMode(WIFI_LIGHT_SLEEP) in ConnectedState
+ * 1. ConnectedState already switches to WIFI_LIGHT_SLEEP while a static
+ *    scene shows and the app is quiet (see LOW_POWER_* in Config.h)
  * 2. Reduce LED brightness when battery is low
  * 3. Increase heartbeat interval to reduce broadcasts
  * 4. Consider deep sleep mode for "off" state (requires hardware button)
@@ -156,7 +149,8 @@ void loop() {
  * TROUBLESHOOTING:
  * ----------------
  * Problem: "0KB Free Memory" crash
- * Solution: Check for memory leaks - ensure states are deleted properly
+ * Solution: Check for leaks and fragmentation - compare free heap with the
+ *           largest free block logged after each transition
  * 
  * Problem: LEDs flicker
  * Solution: Check power supply - MT3608 must output steady 5V
@@ -0,0 +1,55 @@
+#ifndef NATIVE_ADAFRUIT_NEOPIXEL_H
+#define NATIVE_ADAFRUIT_NEOPIXEL_H
+
+#include "Arduino.h"
+#include <vector>
+
+#define NEO_GRB    ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+typedef uint16_t neoPixelType;
+
+// Keeps the pixels (brightness applied at show(), like the real strip) and
+// counts pushes instead of bit-banging them out
+class Adafruit_NeoPixel {
+private:
+    std::vector<uint8_t> pixels;          // RGB, as written
+    uint8_t brightness;
+
+public:
+    uint32_t shows;
+
+    Adafruit_NeoPixel(uint16_t n, int16_t = 6, neoPixelType = NEO_GRB + NEO_KHZ800)
+        : pixels(n * 3), brightness(255), shows(0) {}
+
+    void begin() {}
+    void updateLength(uint16_t n) { pixels.assign(n * 3, 0); }
+    void show() { shows++; }
+    bool canShow() { return true; }
+    void clear() { std::fill(pixels.begin(), pixels.end(), 0); }
+    void setBrightness(uint8_t b) { brightness = b; }
+    uint8_t getBrightness() const { return brightness; }
+    uint16_t numPixels() const { return static_cast<uint16_t>(pixels.size() / 3); }
+
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+        if (n >= numPixels()) return;
+        pixels[n * 3] = r;
+        pixels[n * 3 + 1] = g;
+        pixels[n * 3 + 2] = b;
+    }
+
+    void setPixelColor(uint16_t n, uint32_t c) {
+        setPixelColor(n, static_cast<uint8_t>(c >> 16), static_cast<uint8_t>(c >> 8), static_cast<uint8_t>(c));
+    }
+
+    uint32_t getPixelColor(uint16_t n) const {
+        if (n >= numPixels()) return 0;
+        return (static_cast<uint32_t>(pixels[n * 3]) << 16) | (pixels[n * 3 + 1] << 8) | pixels[n * 3 + 2];
+    }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+        return (static_cast<uint32_t>(r) << 16) | (g << 8) | b;
+    }
+};
+
+#endif // NATIVE_ADAFRUIT_NEOPIXEL_H
@@ -0,0 +1,181 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/**
+** ============================================================================
+** NATIVE ARDUINO - Just enough of the ESP8266 Arduino core to run on a host
+** ============================================================================
+**
+** Used by env:native only (see platformio.ini), ahead of the real core in
+** the include path. Everything is header-only so the firmware, which is
+** header-only too, links without a core library.
+**
+** The stubs behave like an idle, connected lamp: Wi-Fi reports
+** WL_CONNECTED, UDP sends succeed and receive nothing, flash is an erased
+** 4 MB array with NOR write semantics. Tests steer them through Native::.
+**/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define F(x) (x)
+#define PI 3.14159265358979323846
+
+#define D4 2
+#define D6 12
+#define A0 17
+
+using std::max;
+using std::min;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline uint8_t pgm_read_byte(const void* p) { return *static_cast<const uint8_t*>(p); }
+inline uint16_t pgm_read_word(const void* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline uint32_t pgm_read_dword(const void* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline void* memcpy_P(void* dest, const void* src, size_t n) { return memcpy(dest, src, n); }
+
+inline size_t strlcpy(char* dest, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dest, src, n);
+        dest[n] = '\0';
+    }
+    return len;
+}
+
+// Knobs for tests; defaults describe a healthy, connected lamp
+namespace Native {
+    static constexpr size_t FLASH_SIZE = 4 * 1024 * 1024;
+
+    inline int analogValue = 950;         // ~4.0 V through the 330k/100k divider
+    inline bool serialEcho = false;       // Copy Serial output to stdout
+    inline uint32_t freeHeap = 40000;
+    inline uint32_t restarts = 0;         // ESP.restart() calls
+    inline uint8_t flash[FLASH_SIZE];     // Erased by eraseFlash()
+
+    inline std::chrono::steady_clock::time_point startTime() {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    inline void eraseFlash() { memset(flash, 0xFF, sizeof(flash)); }
+}
+
+inline unsigned long micros() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - Native::startTime()).count());
+}
+
+inline unsigned long millis() { return micros() / 1000; }
+
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+inline void yield() {}
+
+inline int analogRead(uint8_t) { return Native::analogValue; }
+
+inline long random(long howsmall, long howbig) {
+    return howsmall >= howbig ? howsmall : howsmall + std::rand() % (howbig - howsmall);
+}
+inline long random(long howbig) { return random(0, howbig); }
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+class String {
+private:
+    std::string s;
+
+public:
+    String(const char* c = "") : s(c ? c : "") {}
+    String(const std::string& other) : s(other) {}
+
+    const char* c_str() const { return s.c_str(); }
+    size_t length() const { return s.size(); }
+    char operator[](size_t i) const { return s[i]; }
+    bool operator==(const char* other) const { return s == other; }
+    String& operator+=(const char* other) { s += other; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+};
+
+enum SerialConfig { SERIAL_8N1, SERIAL_6N1 };
+enum SerialMode { SERIAL_FULL, SERIAL_TX_ONLY };
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    void begin(unsigned long, SerialConfig, SerialMode) {}
+    void flush() { fflush(stdout); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        if (!Native::serialEcho) return 0;
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+
+    size_t print(const char* text) {
+        if (!Native::serialEcho) return 0;
+        fputs(text, stdout);
+        return strlen(text);
+    }
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t println(const char* text = "") { size_t n = print(text); return n + print("\n"); }
+    size_t println(const String& text) { return println(text.c_str()); }
+};
+
+inline HardwareSerial Serial;
+inline HardwareSerial Serial1;      // LED strip 1 (UartOutput)
+
+class EspClass {
+public:
+    static uint32_t getFreeHeap() { return Native::freeHeap; }
+    static uint32_t getMaxFreeBlockSize() { return Native::freeHeap * 3 / 4; }
+    static uint8_t getHeapFragmentation() { return 25; }
+    static uint32_t getChipId() { return 0x00C0FFEE; }
+    static uint32_t getFlashChipSize() { return Native::FLASH_SIZE; }
+    static uint32_t getSketchSize() { return 400 * 1024; }
+    static uint32_t getFreeSketchSpace() { return 600 * 1024; }
+    static uint32_t getCpuFreqMHz() { return 80; }
+    static uint32_t getCycleCount() { return static_cast<uint32_t>(micros() * 80); }
+    static void restart() { Native::restarts++; }
+
+    // Word-aligned like the real API; writes can only clear bits
+    static bool flashEraseSector(uint32_t sector) {
+        if ((sector + 1) * 4096 > Native::FLASH_SIZE) return false;
+        memset(&Native::flash[sector * 4096], 0xFF, 4096);
+        return true;
+    }
+
+    static bool flashWrite(uint32_t address, const uint32_t* data, size_t size) {
+        if ((address | size) & 3 || address + size > Native::FLASH_SIZE) return false;
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) Native::flash[address + i] &= bytes[i];
+        return true;
+    }
+
+    static bool flashRead(uint32_t address, uint32_t* data, size_t size) {
+        if ((address | size) & 3 || address + size > Native::FLASH_SIZE) return false;
+        memcpy(data, &Native::flash[address], size);
+        return true;
+    }
+};
+
+inline EspClass ESP;
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,40 @@
+#ifndef NATIVE_ARDUINOOTA_H
+#define NATIVE_ARDUINOOTA_H
+
+#include "ESP8266WiFi.h"
+#include <functional>
+
+#define U_FLASH 0
+#define U_FS    100
+
+typedef enum {
+    OTA_AUTH_ERROR,
+    OTA_BEGIN_ERROR,
+    OTA_CONNECT_ERROR,
+    OTA_RECEIVE_ERROR,
+    OTA_END_ERROR
+} ota_error_t;
+
+// Accepts the configuration and never sees an upload
+class ArduinoOTAClass {
+public:
+    typedef std::function<void()> THandlerFunction;
+    typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+    typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+
+    void setHostname(const char*) {}
+    void setPassword(const char*) {}
+    void setRebootOnSuccess(bool) {}
+    void onStart(THandlerFunction) {}
+    void onEnd(THandlerFunction) {}
+    void onError(THandlerFunction_Error) {}
+    void onProgress(THandlerFunction_Progress) {}
+    void begin(bool = true) {}
+    void end() {}
+    void handle() {}
+    int getCommand() { return U_FLASH; }
+};
+
+inline ArduinoOTAClass ArduinoOTA;
+
+#endif // NATIVE_ARDUINOOTA_H
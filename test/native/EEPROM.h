@@ -0,0 +1,25 @@
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+
+#include "Arduino.h"
+
+// A blank (0xFF) emulated EEPROM
+class EEPROMClass {
+private:
+    uint8_t data[4096];
+    size_t size = 0;
+
+public:
+    EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+
+    void begin(size_t n) { size = n < sizeof(data) ? n : sizeof(data); }
+    uint8_t read(int address) { return static_cast<size_t>(address) < size ? data[address] : 0; }
+    void write(int address, uint8_t value) { if (static_cast<size_t>(address) < size) data[address] = value; }
+    bool commit() { return true; }
+    bool end() { size = 0; return true; }
+    size_t length() { return size; }
+};
+
+inline EEPROMClass EEPROM;
+
+#endif // NATIVE_EEPROM_H
@@ -0,0 +1,25 @@
+#ifndef NATIVE_ESP8266HTTPCLIENT_H
+#define NATIVE_ESP8266HTTPCLIENT_H
+
+#include "ESP8266WiFi.h"
+
+enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_PARTIAL_CONTENT = 206,
+    HTTP_CODE_NOT_FOUND = 404
+};
+
+// Every request fails to connect
+class HTTPClient {
+public:
+    bool begin(WiFiClient&, const char*) { return true; }
+    void end() {}
+    void setTimeout(uint16_t) {}
+    void setReuse(bool) {}
+    void addHeader(const char*, const char*) {}
+    int GET() { return -1; }                  // HTTPC_ERROR_CONNECTION_FAILED
+    int getSize() { return -1; }
+    WiFiClient* getStreamPtr() { return nullptr; }
+};
+
+#endif // NATIVE_ESP8266HTTPCLIENT_H
@@ -0,0 +1,88 @@
+#ifndef NATIVE_ESP8266WIFI_H
+#define NATIVE_ESP8266WIFI_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+enum wl_status_t {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_WRONG_PASSWORD = 6,
+    WL_DISCONNECTED = 7
+};
+
+enum WiFiMode_t { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 };
+enum WiFiSleepType_t { WIFI_NONE_SLEEP = 0, WIFI_LIGHT_SLEEP = 1, WIFI_MODEM_SLEEP = 2 };
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+struct bss_info {
+    uint8_t bssid[6];
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t channel;
+    int8_t rssi;
+};
+
+namespace Native {
+    inline wl_status_t wifiStatus = WL_CONNECTED;
+}
+
+class ESP8266WiFiClass {
+private:
+    WiFiMode_t wifiMode = WIFI_STA;
+    WiFiSleepType_t sleepMode = WIFI_MODEM_SLEEP;
+    uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+public:
+    wl_status_t status() { return Native::wifiStatus; }
+    bool mode(WiFiMode_t m) { wifiMode = m; return true; }
+    WiFiMode_t getMode() { return wifiMode; }
+
+    wl_status_t begin(const char*, const char* = nullptr, int32_t = 0, const uint8_t* = nullptr, bool = true) {
+        return Native::wifiStatus;
+    }
+    bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress()) { return true; }
+    bool disconnect(bool = false) { return true; }
+
+    IPAddress localIP() { return IPAddress(192, 168, 1, 42); }
+    IPAddress gatewayIP() { return IPAddress(192, 168, 1, 1); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress dnsIP(uint8_t = 0) { return IPAddress(192, 168, 1, 1); }
+    int32_t RSSI() { return -55; }
+    uint8_t* BSSID() { return bssid; }
+    int32_t channel() { return 6; }
+
+    // Scans complete at once and find nothing
+    int8_t scanNetworks(bool = false, bool = false) { return 0; }
+    int8_t scanComplete() { return 0; }
+    void scanDelete() {}
+    const bss_info* getScanInfoByIndex(int) { return nullptr; }
+
+    bool softAP(const char*, const char* = nullptr) { return true; }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    bool softAPdisconnect(bool = false) { return true; }
+
+    bool setSleepMode(WiFiSleepType_t type, uint8_t = 0) { sleepMode = type; return true; }
+    WiFiSleepType_t getSleepMode() { return sleepMode; }
+};
+
+inline ESP8266WiFiClass WiFi;
+
+// Never connects; FirmwareDownload only runs when a test asks for it
+class WiFiClient {
+public:
+    virtual ~WiFiClient() = default;
+    int available() { return 0; }
+    uint8_t connected() { return 0; }
+    size_t readBytes(uint8_t*, size_t) { return 0; }
+    size_t write(const uint8_t*, size_t len) { return len; }
+    void stop() {}
+};
+
+#endif // NATIVE_ESP8266WIFI_H
@@ -0,0 +1,41 @@
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include "Arduino.h"
+
+class IPAddress {
+private:
+    uint8_t octets[4];
+
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    IPAddress(uint32_t address) { memcpy(octets, &address, sizeof(octets)); }
+
+    operator uint32_t() const {
+        uint32_t address;
+        memcpy(&address, octets, sizeof(address));
+        return address;
+    }
+
+    uint8_t operator[](int i) const { return octets[i]; }
+    uint8_t& operator[](int i) { return octets[i]; }
+    bool operator==(const IPAddress& other) const { return memcmp(octets, other.octets, sizeof(octets)) == 0; }
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+    bool isSet() const { return static_cast<uint32_t>(*this) != 0; }
+
+    bool fromString(const char* text) {
+        unsigned a, b, c, d;
+        if (sscanf(text, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || (a | b | c | d) > 255) return false;
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+        return String(text);
+    }
+};
+
+#endif // NATIVE_IPADDRESS_H
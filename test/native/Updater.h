@@ -0,0 +1,25 @@
+#ifndef NATIVE_UPDATER_H
+#define NATIVE_UPDATER_H
+
+#include "Arduino.h"
+
+#ifndef U_FLASH
+#define U_FLASH 0
+#endif
+
+// Accepts an image and throws it away
+class UpdaterClass {
+private:
+    size_t size = 0;
+    size_t written = 0;
+
+public:
+    bool begin(size_t n, int = U_FLASH) { size = n; written = 0; return true; }
+    size_t write(uint8_t*, size_t len) { written += len; return len; }
+    bool end(bool evenIfRemaining = false) { bool ok = written == size || evenIfRemaining; size = 0; return ok; }
+    size_t progress() { return written; }
+};
+
+inline UpdaterClass Update;
+
+#endif // NATIVE_UPDATER_H
@@ -0,0 +1,14 @@
+#ifndef NATIVE_WIFICLIENTSECURE_H
+#define NATIVE_WIFICLIENTSECURE_H
+
+#include "ESP8266WiFi.h"
+
+namespace BearSSL {
+    class WiFiClientSecure : public WiFiClient {
+    public:
+        void setInsecure() {}
+        void setBufferSizes(int, int) {}
+    };
+}
+
+#endif // NATIVE_WIFICLIENTSECURE_H
@@ -0,0 +1,59 @@
+#ifndef NATIVE_WIFIUDP_H
+#define NATIVE_WIFIUDP_H
+
+#include "ESP8266WiFi.h"
+
+namespace Native {
+    inline uint32_t udpPacketsSent = 0;
+}
+
+// Sends are counted and dropped. Receives only see what a test queued with
+// replay(): one datagram, delivered `count` times, without touching the heap
+class WiFiUDP {
+private:
+    uint8_t packet[1472] = {};
+    size_t packetLen = 0;
+    size_t readPos = 0;
+    uint32_t pending = 0;
+    bool current = false;
+
+public:
+    uint8_t begin(uint16_t) { return 1; }
+    uint8_t beginMulticast(IPAddress, IPAddress, uint16_t) { return 1; }
+    void stop() { pending = 0; current = false; }
+
+    void replay(const uint8_t* data, size_t len, uint32_t count) {
+        packetLen = len < sizeof(packet) ? len : sizeof(packet);
+        memcpy(packet, data, packetLen);
+        pending = count;
+        current = false;
+    }
+
+    int parsePacket() {
+        current = pending > 0;
+        if (!current) return 0;
+        pending--;
+        readPos = 0;
+        return static_cast<int>(packetLen);
+    }
+    int available() { return current ? static_cast<int>(packetLen - readPos) : 0; }
+    int read() { return available() > 0 ? packet[readPos++] : -1; }
+    int read(uint8_t* out, size_t len) {
+        size_t n = static_cast<size_t>(available());
+        if (n > len) n = len;
+        memcpy(out, packet + readPos, n);
+        readPos += n;
+        return static_cast<int>(n);
+    }
+    int peek() { return available() > 0 ? packet[readPos] : -1; }
+    void flush() {}
+    IPAddress remoteIP() { return IPAddress(192, 168, 1, 10); }
+    uint16_t remotePort() { return 4210; }
+
+    int beginPacket(IPAddress, uint16_t) { return 1; }
+    size_t write(const uint8_t*, size_t len) { return len; }
+    size_t write(uint8_t) { return 1; }
+    int endPacket() { Native::udpPacketsSent++; return 1; }
+};
+
+#endif // NATIVE_WIFIUDP_H
@@ -0,0 +1,17 @@
+#ifndef NATIVE_BEARSSL_HASH_H
+#define NATIVE_BEARSSL_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Not a real SHA-256: the digest is always zero, so verified updates fail
+typedef struct {
+    uint64_t count;
+} br_sha256_context;
+
+inline void br_sha256_init(br_sha256_context* ctx) { ctx->count = 0; }
+inline void br_sha256_update(br_sha256_context* ctx, const void*, size_t len) { ctx->count += len; }
+inline void br_sha256_out(const br_sha256_context*, void* out) { memset(out, 0, 32); }
+
+#endif // NATIVE_BEARSSL_HASH_H
@@ -0,0 +1,24 @@
+#ifndef NATIVE_EBOOT_COMMAND_H
+#define NATIVE_EBOOT_COMMAND_H
+
+#include <stdint.h>
+
+enum action_t {
+    ACTION_COPY_RAW = 0x00000001,
+    ACTION_LOAD_APP = 0xffffffff
+};
+
+struct eboot_command {
+    uint32_t magic;
+    enum action_t action;
+    uint32_t args[29];
+    uint32_t crc32;
+};
+
+namespace Native {
+    inline eboot_command lastEbootCommand{};
+}
+
+inline void eboot_command_write(struct eboot_command* cmd) { Native::lastEbootCommand = *cmd; }
+
+#endif // NATIVE_EBOOT_COMMAND_H
@@ -0,0 +1,24 @@
+#ifndef NATIVE_ESP8266_PERI_H
+#define NATIVE_ESP8266_PERI_H
+
+#include <stdint.h>
+
+// UART registers as plain memory: writes land here, nothing is transmitted
+namespace Native {
+    inline volatile uint32_t uartRegisters[2][8];
+}
+
+#define USF(u)   Native::uartRegisters[u][0]    // FIFO
+#define USIS(u)  Native::uartRegisters[u][1]    // Interrupt status
+#define USIE(u)  Native::uartRegisters[u][2]    // Interrupt enable
+#define USIC(u)  Native::uartRegisters[u][3]    // Interrupt clear
+#define USS(u)   Native::uartRegisters[u][4]    // Status
+#define USC0(u)  Native::uartRegisters[u][5]
+#define USC1(u)  Native::uartRegisters[u][6]
+
+#define UIFE     1                  // TX FIFO empty interrupt
+#define USTXC    16                 // TX FIFO count, in USS
+#define UCTXI    22                 // Invert TX, in USC0
+#define UCFET    8                  // TX FIFO empty threshold, in USC1
+
+#endif // NATIVE_ESP8266_PERI_H
@@ -0,0 +1,9 @@
+#ifndef NATIVE_ETS_SYS_H
+#define NATIVE_ETS_SYS_H
+
+// No interrupts natively: attaching a handler does nothing
+#define ETS_UART_INTR_ATTACH(handler, arg) ((void)(handler), (void)(arg))
+#define ETS_UART_INTR_ENABLE()
+#define ETS_UART_INTR_DISABLE()
+
+#endif // NATIVE_ETS_SYS_H
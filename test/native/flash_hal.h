@@ -0,0 +1,9 @@
+#ifndef NATIVE_FLASH_HAL_H
+#define NATIVE_FLASH_HAL_H
+
+// Layout of eagle.flash.4m2m.ld, as in platformio.ini
+#define SPI_FLASH_SEC_SIZE 4096
+#define FS_PHYS_ADDR       0x00200000u
+#define FS_PHYS_SIZE       0x001FA000u
+
+#endif // NATIVE_FLASH_HAL_H
@@ -0,0 +1,378 @@
+/**
+** ============================================================================
+** BENCHMARKS - Cost of a frame and of a command, on the host
+** ============================================================================
+**
+** Run with `pio test -e native -f test_bench`. Every benchmark reports the
+** mean time per operation and the heap allocations per operation (counted by
+** the global operator new below). The allocation counts are exact and must
+** stay at zero on the hot paths, so those are checked as tests. The times
+** come from a desktop CPU: compare them between runs on the same machine,
+** not with the ESP8266.
+**
+** Results are written as JSON to $LUMINA_BENCH_OUT (default
+** bench_results.json in the working directory):
+**
+**   {"schema": 1, "firmware": "1.0.0", "compiler": "...",
+**    "results": [{"name": "strategy/Calm", "unit": "frame",
+**                 "iterations": 200000, "ns_per_op": 41.2,
+**                 "allocs_per_op": 0}, ...]}
+**
+** Names are stable across releases; add new ones rather than renaming.
+**/
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "LuminaStateManager.h"
+
+// ============================================================================
+// ALLOCATION COUNTER
+// ============================================================================
+// GCC can't see that these replace the global operators and warns on free()
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+namespace {
+    size_t allocationCount = 0;
+}
+
+void* operator new(size_t size) {
+    allocationCount++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// ============================================================================
+// HARNESS
+// ============================================================================
+namespace {
+    struct BenchResult {
+        std::string name;
+        const char* unit;
+        uint32_t iterations;
+        double nsPerOp;
+        double allocsPerOp;
+    };
+
+    std::vector<BenchResult> results;
+    volatile uint8_t sink;                // Keeps frames observable to the optimizer
+
+    /**
+     * Time `op(i)` over `iterations` calls after a short warm-up, record the
+     * result under `name` and return it.
+     */
+    template <typename Op>
+    const BenchResult& bench(const std::string& name, const char* unit, uint32_t iterations, Op op) {
+        for (uint32_t i = 0; i < iterations / 10; i++) op(i);
+
+        size_t allocationsBefore = allocationCount;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++) op(i);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        size_t allocations = allocationCount - allocationsBefore;
+
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        results.push_back({name, unit, iterations, ns / iterations,
+                           static_cast<double>(allocations) / iterations});
+
+        const BenchResult& result = results.back();
+        printf("[BENCH] %-28s %10.1f ns/%s %8.3f allocs/%s\n",
+               name.c_str(), result.nsPerOp, unit, result.allocsPerOp, unit);
+        return result;
+    }
+
+    void writeResults(const char* path) {
+        FILE* out = fopen(path, "w");
+        if (!out) {
+            fprintf(stderr, "[BENCH] ✗ Cannot write %s\n", path);
+            return;
+        }
+
+        fprintf(out, "{\n  \"schema\": 1,\n  \"firmware\": \"%s\",\n  \"compiler\": \"%s\",\n  \"results\": [\n",
+                FIRMWARE_VERSION, __VERSION__);
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            fprintf(out, "    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %u, "
+                         "\"ns_per_op\": %.2f, \"allocs_per_op\": %.4f}%s\n",
+                    r.name.c_str(), r.unit, r.iterations, r.nsPerOp, r.allocsPerOp,
+                    i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+        fclose(out);
+        printf("[BENCH] Wrote %zu results to %s\n", results.size(), path);
+    }
+
+    // One firmware instance for the whole run: states are singletons bound
+    // to the first manager that asks for them
+    LuminaStateManager& lamp() {
+        static LuminaStateManager* manager = [] {
+            Native::eraseFlash();
+            auto* m = new LuminaStateManager();
+            m->begin();
+            m->transitionTo(createConnectedState(m));
+            return m;
+        }();
+        return *manager;
+    }
+
+    Profiler profiler;                    // For the FrameBuffers built here
+
+    const Scene CALM = Scene::of(STRATEGY_CALM, Color(0, 120, 255));
+    const Scene PARTY = Scene::of(STRATEGY_PARTY, Color(255, 0, 0), Color(0, 255, 0), Color(0, 0, 255));
+
+    // The README's example: a comet of scene color 0 with a fading tail
+    const uint8_t COMET[] = {
+        0x01, 0x00,                                   // Format 1, no program colors
+        0x09, 0x00, 0xD0, 0x07,                       // TIME  r0, 2000 ms
+        0x08, 0x00, 0x0C,                             // SHR   r0, 12     head = 0..15
+        0x01, 0x03, LED_COUNT, 0x00,                  // SET   r3, LED_COUNT
+        0x0D, 0x01, 0x00,                             // LOOP  r1, every pixel
+        0x02, 0x20,                                   //   MOV r2, r0
+        0x04, 0x21,                                   //   SUB r2, r1
+        0x06, 0x23,                                   //   MOD r2, r3     pixels behind the head
+        0x0C, 0x02, 0x05, 0, 255, 1, 160, 2, 80, 3, 30, 4, 0, // KEYS r2: tail levels
+        0x0F, 0x12, 0x00,                             //   PIXEL r1, level r2, color 0
+        0x0E,                                         // NEXT
+        0x00                                          // END
+    };
+}
+
+// ============================================================================
+// STRATEGIES - LightingStrategy::apply(), one frame per call
+// ============================================================================
+template <typename Strategy, typename... Args>
+static void benchStrategy(const Scene& scene, Args... args) {
+    NeoPixelOutput strip(LED_PIN);
+    FrameBuffer frame(&strip, &profiler);
+    frame.begin();
+    Strategy strategy(scene, args...);
+    LightingStrategy* volatile target = &strategy; // Through the vtable, as the engine calls it
+
+    const BenchResult& r = bench(std::string("strategy/") + strategy.getName(), "frame", 200000,
+                                 [&](uint32_t i) {
+        target->apply(&frame, i * FADE_SPEED);
+        sink = frame.data()[0];
+    });
+    EXPECT_EQ(r.allocsPerOp, 0) << r.name;
+}
+
+TEST(Strategies, Solid) { benchStrategy<SolidColorStrategy>(Scene::of(STRATEGY_SOLID, Color(255, 180, 90))); }
+TEST(Strategies, Calm) { benchStrategy<CalmBreathingStrategy>(CALM); }
+TEST(Strategies, Focus) { benchStrategy<FocusStrategy>(Scene::of(STRATEGY_FOCUS, Color(255, 240, 220))); }
+TEST(Strategies, Party) { benchStrategy<PartyStrategy>(PARTY); }
+TEST(Strategies, Gradient) { benchStrategy<GradientStrategy>(Scene::of(STRATEGY_GRADIENT, Color(255, 60, 0), Color(120, 0, 255), Color(0, 200, 160))); }
+
+TEST(Strategies, Script) {
+    ScriptProgram program;
+    ScriptAnalysis analysis = program.load(COMET, sizeof(COMET));
+    ASSERT_EQ(analysis.result, Script::OK) << "at byte " << analysis.offset;
+    EXPECT_EQ(analysis.steps, 5 + 6 * LED_MAX);    // 4 + END, 6 per pixel of the longest layout
+
+    benchStrategy<ScriptStrategy>(PARTY, &program);
+}
+
+// ============================================================================
+// RENDER PIPELINE - engine cross-fade and the push to the strip
+// ============================================================================
+TEST(Render, Crossfade) {
+    NeoPixelOutput strip(LED_PIN);
+    FrameBuffer frame(&strip, &profiler);
+    frame.begin();
+    LightingEngine engine;
+    engine.setActive(true);
+    engine.setScene(CALM);
+    engine.setScene(PARTY, 60000);        // Long enough to stay mid-fade throughout
+
+    unsigned long start = millis();
+    const BenchResult& r = bench("render/crossfade", "frame", 100000, [&](uint32_t i) {
+        engine.render(&frame, start + (i % 1000));
+        sink = frame.data()[0];
+    });
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Render, ShowChanged) {
+    NeoPixelOutput strip(LED_PIN);
+    FrameBuffer frame(&strip, &profiler);
+    frame.begin();
+    frame.setCurrentLimit(POWER_BUDGET_MAX);
+
+    const BenchResult& r = bench("show/changed", "frame", 200000, [&](uint32_t i) {
+        frame.fill(Color(static_cast<uint8_t>(i), 200, 255));
+        frame.show();
+    });
+    EXPECT_EQ(r.allocsPerOp, 0);
+    EXPECT_GT(strip.getFrames(), 0u);
+}
+
+TEST(Render, ShowUnchanged) {
+    NeoPixelOutput strip(LED_PIN);
+    FrameBuffer frame(&strip, &profiler);
+    frame.begin();
+    frame.fill(Color(255, 180, 90));
+    frame.show();
+
+    const BenchResult& r = bench("show/unchanged", "frame", 200000, [&](uint32_t) {
+        frame.show();
+    });
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+// ============================================================================
+// PROFILER - cost of one probe, which stays in production builds
+// ============================================================================
+// On the host the two cycle-counter reads are clock calls, so this is an
+// upper bound; on the ESP8266 each one is a single register read
+TEST(Profiler, Probe) {
+    Profiler probes;
+    const BenchResult& r = bench("profiler/probe", "probe", 1000000, [&](uint32_t) {
+        PROFILE_SCOPE(&probes, PROFILE_RENDER);
+    });
+    EXPECT_EQ(r.allocsPerOp, 0);
+
+    uint8_t packet[Profiler::PACKET_SIZE];
+    EXPECT_EQ(probes.encode(packet), Profiler::PACKET_SIZE);
+}
+
+// ============================================================================
+// COMMANDS - ConnectedState::handleCommand(), one packet per call
+// ============================================================================
+static const BenchResult& benchCommand(const char* name, uint8_t cmd, std::vector<uint8_t> payload,
+                                       uint32_t iterations = 100000) {
+    LuminaState* state = lamp().getCurrentState();
+    EXPECT_EQ(state->getStateCode(), STATE_CONNECTED);
+
+    return bench(std::string("command/") + name, "packet", iterations, [&](uint32_t) {
+        state->handleCommand(cmd, payload.data(), payload.size());
+    });
+}
+
+TEST(Commands, SetColor) {
+    const BenchResult& r = benchCommand("set_color", CMD_SET_COLOR, {255, 120, 0});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, SetBrightness) {
+    const BenchResult& r = benchCommand("set_brightness", CMD_SET_BRIGHTNESS, {128});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, SetMoodCalm) {
+    const BenchResult& r = benchCommand("set_mood_calm", CMD_SET_MOOD, {0, 0, 120, 255});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, SetMoodPartyFade) {
+    const BenchResult& r = benchCommand("set_mood_party_fade", CMD_SET_MOOD,
+                                        {2, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0xF4, 0x01});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, Batch) {
+    const BenchResult& r = benchCommand("batch_3", CMD_BATCH,
+                                        {4, CMD_SET_COLOR, 255, 0, 0,
+                                         2, CMD_SET_BRIGHTNESS, 200,
+                                         5, CMD_SET_MOOD, 1, 255, 240, 220});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+// A short entry must reject the whole batch, not just itself
+TEST(Commands, BatchShortEntry) {
+    LuminaState* state = lamp().getCurrentState();
+    uint8_t calm[] = {0, 10, 20, 30};
+    state->handleCommand(CMD_SET_MOOD, calm, sizeof(calm));
+
+    uint8_t batch[] = {5, CMD_SET_MOOD, 1, 255, 0, 0,
+                       1, CMD_SET_MOOD};
+    state->handleCommand(CMD_BATCH, batch, sizeof(batch));
+
+    Color shown = lamp().getLighting()->getScene().color(0);
+    EXPECT_EQ(shown.r, 10);
+    EXPECT_EQ(shown.g, 20);
+    EXPECT_EQ(shown.b, 30);
+}
+
+TEST(Commands, Subscribe) {
+    const BenchResult& r = benchCommand("subscribe", CMD_SUBSCRIBE, {60, 0, 0x72, 0x10});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, GetStatus) {
+    const BenchResult& r = benchCommand("get_status", CMD_GET_STATUS, {});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, GetProfile) {
+    const BenchResult& r = benchCommand("get_profile", CMD_GET_PROFILE, {0});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, SyncClock) {
+    const BenchResult& r = benchCommand("sync_clock", CMD_SYNC_CLOCK, {0x40, 0x42, 0x0F, 0x00});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, PeerHeartbeat) {
+    HeartbeatSnapshot peer{};
+    peer.clockRank = 0x10;                // Below the stub's chip ID (unless the app leads)
+    uint8_t packet[HB_MAX_PACKET_SIZE];
+    HeartbeatEncoder encoder;
+    size_t len = encoder.encode(peer, false, millis(), packet);
+
+    const BenchResult& r = benchCommand("peer_heartbeat", packet[0],
+                                        std::vector<uint8_t>(packet + 1, packet + len));
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, GroupMember) {
+    lamp().applyGroups(0x00000004);       // Group 3
+    const BenchResult& r = benchCommand("group_set_mood", CMD_GROUP, {3, CMD_SET_MOOD, 0, 0, 120, 255});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, GroupOther) {
+    const BenchResult& r = benchCommand("group_filtered", CMD_GROUP, {7, CMD_SET_MOOD, 0, 0, 120, 255});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+TEST(Commands, SetPowerBudget) {
+    const BenchResult& r = benchCommand("set_power_budget", CMD_SET_POWER_BUDGET, {0x20, 0x03});
+    EXPECT_EQ(r.allocsPerOp, 0);
+}
+
+// ============================================================================
+// INTAKE - a full drain: socket -> shared packet buffer -> command table
+// ============================================================================
+TEST(Intake, DrainBudget) {
+    LuminaStateManager& manager = lamp();
+    WiFiUDP socket;
+    const uint8_t packet[] = {CMD_SET_MOOD, 0, 0, 120, 255};
+
+    const BenchResult& r = bench("intake/drain_16", "drain", 20000, [&](uint32_t) {
+        socket.replay(packet, sizeof(packet), UDP_BATCH_BUDGET);
+        IntakeStats stats = manager.receiveCommands(socket);
+        sink = static_cast<uint8_t>(stats.received);
+    });
+    EXPECT_EQ(r.allocsPerOp, 0);
+    EXPECT_EQ(manager.getCurrentState()->getStateCode(), STATE_CONNECTED);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+
+    const char* path = std::getenv("LUMINA_BENCH_OUT");
+    writeResults(path && *path ? path : "bench_results.json");
+    return status;
+}